@@ -49,6 +49,7 @@
 #define FISH_INFO_FILE          "info"
 
 #define MC_EXTFS_DIR            "extfs.d"
+#define MC_EXTFS_CACHE_DIR      "extfs"
 
 #define MC_BASHRC_FILE          "bashrc"
 #define MC_CONFIG_FILE          "ini"
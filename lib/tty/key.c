@@ -2082,8 +2082,7 @@ tty_get_event (struct Gpm_Event *event, gboolean redo_event, gboolean block)
 
             if (seconds != 0)
             {
-                /* the timeout could be improved and actually be
-                 * the number of seconds until the next vfs entry
+                /* the number of seconds until the next vfs entry
                  * timeouts in the stamp list.
                  */
 
@@ -2107,7 +2106,7 @@ tty_get_event (struct Gpm_Event *event, gboolean redo_event, gboolean block)
         /* select timed out: it could be for any of the following reasons:
          * redo_event -> it was because of the MOU_REPEAT handler
          * !block     -> we did not block in the select call
-         * else       -> 10 second timeout to check the vfs status.
+         * else       -> timeout of the next vfs entry in the stamp list.
          */
         if (flag == 0)
         {
@@ -83,6 +83,15 @@
 
 #define CALL(x) if (MEDATA->x) MEDATA->x
 
+/* directories with more entries get the name index */
+#define VFS_S_INDEX_MIN 32
+
+/* average size of entry name and other data of inode, used to estimate memory usage */
+#define VFS_S_NAME_SIZE 64
+
+/* number of objects allocated at once by arena of superblock */
+#define VFS_S_ARENA_CHUNK 256
+
 /*** file scope type declarations ****************************************************************/
 
 struct dirhandle
@@ -91,6 +100,27 @@ struct dirhandle
     struct vfs_s_inode *dir;
 };
 
+/* Objects of one size allocated from chunks of arena */
+typedef struct
+{
+    gsize size;                 /* object size */
+    char *next;                 /* first unused object of the last chunk */
+    guint left;                 /* number of unused objects in the last chunk */
+    gpointer freed;             /* freed objects linked through their first pointer */
+} vfs_s_pool_t;
+
+/* Arena of superblock: inodes and entries of the tree are allocated in big
+   chunks, which are freed at once together with superblock.
+   Names aren't kept here: they have various sizes, so memory of names of freed
+   entries couldn't be reused, and ftpfs/fish superblocks which reload directories
+   would grow until the connection is closed */
+struct vfs_s_arena
+{
+    GSList *chunks;
+    vfs_s_pool_t inodes;
+    vfs_s_pool_t entries;
+};
+
 /*** file scope variables ************************************************************************/
 
 static volatile int total_inodes = 0, total_entries = 0;
@@ -98,13 +128,182 @@ static volatile int total_inodes = 0, total_entries = 0;
 /*** file scope functions ************************************************************************/
 /* --------------------------------------------------------------------------------------------- */
 
-static int
-vfs_s_entry_compare (const void *a, const void *b)
+static gpointer
+vfs_s_pool_alloc (struct vfs_s_arena *arena, vfs_s_pool_t * pool)
+{
+    gpointer obj;
+
+    if (pool->freed != NULL)
+    {
+        obj = pool->freed;
+        pool->freed = *(gpointer *) obj;
+    }
+    else
+    {
+        if (pool->left == 0)
+        {
+            pool->next = g_try_malloc (pool->size * VFS_S_ARENA_CHUNK);
+            if (pool->next == NULL)
+                return NULL;
+            arena->chunks = g_slist_prepend (arena->chunks, pool->next);
+            pool->left = VFS_S_ARENA_CHUNK;
+        }
+
+        obj = pool->next;
+        pool->next += pool->size;
+        pool->left--;
+    }
+
+    memset (obj, 0, pool->size);
+    return obj;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static inline void
+vfs_s_pool_free (vfs_s_pool_t * pool, gpointer obj)
+{
+    *(gpointer *) obj = pool->freed;
+    pool->freed = obj;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static struct vfs_s_arena *
+vfs_s_get_arena (struct vfs_s_super *super)
 {
-    const struct vfs_s_entry *e = (const struct vfs_s_entry *) a;
-    const char *name = (const char *) b;
+    if (super->arena == NULL)
+    {
+        super->arena = g_new0 (struct vfs_s_arena, 1);
+        super->arena->inodes.size = sizeof (struct vfs_s_inode);
+        super->arena->entries.size = sizeof (struct vfs_s_entry);
+    }
+
+    return super->arena;
+}
+
+/* --------------------------------------------------------------------------------------------- */
 
-    return strcmp (e->name, name);
+static void
+vfs_s_free_arena (struct vfs_s_super *super)
+{
+    if (super->arena != NULL)
+    {
+        g_slist_foreach (super->arena->chunks, (GFunc) g_free, NULL);
+        g_slist_free (super->arena->chunks);
+        g_free (super->arena);
+        super->arena = NULL;
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+vfs_s_index_free (struct vfs_s_inode *dir)
+{
+    if (dir->subdir_index != NULL)
+    {
+        g_hash_table_destroy (dir->subdir_index);
+        dir->subdir_index = NULL;
+    }
+    dir->subdir_dups = 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+vfs_s_index_add (struct vfs_s_inode *dir, GList *link)
+{
+    const char *name = ((struct vfs_s_entry *) link->data)->name;
+
+    /* like the linear search, the index finds the first entry of duplicated names */
+    if (g_hash_table_lookup (dir->subdir_index, name) == NULL)
+        g_hash_table_insert (dir->subdir_index, (gpointer) name, link);
+    else
+        dir->subdir_dups++;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Find link of entry in the directory.
+ * The index is created when directory turns out to be big.
+ */
+
+static GList *
+vfs_s_find_link (struct vfs_s_inode *dir, const char *name)
+{
+    GList *iter;
+    int n = 0;
+
+    if (dir->subdir_index != NULL)
+        return (GList *) g_hash_table_lookup (dir->subdir_index, name);
+
+    for (iter = dir->subdir; iter != NULL; iter = g_list_next (iter))
+    {
+        if (strcmp (((struct vfs_s_entry *) iter->data)->name, name) == 0)
+            return iter;
+
+        if (++n == VFS_S_INDEX_MIN)
+        {
+            /* keys are names of entries, they live while entries are in directory */
+            dir->subdir_index = g_hash_table_new (g_str_hash, g_str_equal);
+            dir->subdir_dups = 0;
+            for (iter = dir->subdir; iter != NULL; iter = g_list_next (iter))
+                vfs_s_index_add (dir, iter);
+            return (GList *) g_hash_table_lookup (dir->subdir_index, name);
+        }
+    }
+
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+vfs_s_remove_link (struct vfs_s_inode *dir, struct vfs_s_entry *ent)
+{
+    GList *link = NULL;
+
+    if (dir->subdir_index != NULL)
+    {
+        link = (GList *) g_hash_table_lookup (dir->subdir_index, ent->name);
+        if (link != NULL && link->data == ent)
+        {
+            /* key is the name of removed entry */
+            g_hash_table_remove (dir->subdir_index, ent->name);
+
+            if (dir->subdir_dups > 0)
+            {
+                GList *iter;
+
+                /* index the next entry with the same name */
+                for (iter = g_list_next (link); iter != NULL; iter = g_list_next (iter))
+                    if (strcmp (((struct vfs_s_entry *) iter->data)->name, ent->name) == 0)
+                    {
+                        g_hash_table_insert (dir->subdir_index,
+                                             ((struct vfs_s_entry *) iter->data)->name, iter);
+                        dir->subdir_dups--;
+                        break;
+                    }
+            }
+        }
+        else
+        {
+            /* entry with duplicated name is not in the index */
+            if (link != NULL)
+                dir->subdir_dups--;
+            link = NULL;
+        }
+    }
+
+    if (link == NULL)
+        link = g_list_find (dir->subdir, ent);
+    if (link == NULL)
+        return;
+
+    if (link == dir->subdir_last)
+        dir->subdir_last = g_list_previous (link);
+    dir->subdir = g_list_delete_link (dir->subdir, link);
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -122,6 +321,8 @@ vfs_s_free_inode (struct vfs_class *me, struct vfs_s_inode *ino)
         return;
     }
 
+    /* entries are removed from the head of list, the index isn't needed for that */
+    vfs_s_index_free (ino);
     while (ino->subdir != NULL)
         vfs_s_free_entry (me, (struct vfs_s_entry *) ino->subdir->data);
 
@@ -134,7 +335,7 @@ vfs_s_free_inode (struct vfs_class *me, struct vfs_s_inode *ino)
     }
     total_inodes--;
     ino->super->ino_usage--;
-    g_free (ino);
+    vfs_s_pool_free (&ino->super->arena->inodes, ino);
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -220,6 +421,7 @@ vfs_s_find_entry_tree (struct vfs_class *me, struct vfs_s_inode *root,
     while (root != NULL)
     {
         GList *iter;
+        char c;
 
         while (*path == PATH_SEP)       /* Strip leading '/' */
             path++;
@@ -233,13 +435,11 @@ vfs_s_find_entry_tree (struct vfs_class *me, struct vfs_s_inode *root,
         for (pseg = 0; path[pseg] != '\0' && path[pseg] != PATH_SEP; pseg++)
             ;
 
-        for (iter = root->subdir; iter != NULL; iter = g_list_next (iter))
-        {
-            ent = (struct vfs_s_entry *) iter->data;
-            if (strlen (ent->name) == pseg && strncmp (ent->name, path, pseg) == 0)
-                /* FOUND! */
-                break;
-        }
+        /* path is our own copy, so the segment can be terminated in place */
+        c = path[pseg];
+        path[pseg] = '\0';
+        iter = vfs_s_find_link (root, path);
+        path[pseg] = c;
 
         ent = iter != NULL ? (struct vfs_s_entry *) iter->data : NULL;
 
@@ -292,11 +492,53 @@ split_dir_name (struct vfs_class *me, char *path, char **dir, char **name, char
 
 /* --------------------------------------------------------------------------------------------- */
 
+/**
+ * Move local copies of files which are not changed on the server from the
+ * expired listing of directory to the new one, so they are not retrieved again.
+ * Listings of ftp servers and 'ls -l' give time up to minutes (or only the date
+ * for old files), so file changed in the same minute would look unchanged.
+ * Thus local copy is moved only if time of file has seconds: then listing
+ * gives time up to seconds (e.g. fish with perl on the server).
+ */
+
+static void
+vfs_s_move_local_copies (struct vfs_s_inode *old_dir, struct vfs_s_inode *new_dir)
+{
+    GList *iter;
+
+    for (iter = old_dir->subdir; iter != NULL; iter = g_list_next (iter))
+    {
+        struct vfs_s_inode *old_ino = ((struct vfs_s_entry *) iter->data)->ino;
+        struct vfs_s_inode *ino;
+        GList *link;
+
+        /* skip files which are open or have other links */
+        if (old_ino->localname == NULL || old_ino->st.st_nlink > 1)
+            continue;
+
+        link = vfs_s_find_link (new_dir, ((struct vfs_s_entry *) iter->data)->name);
+        if (link == NULL)
+            continue;
+
+        ino = ((struct vfs_s_entry *) link->data)->ino;
+        if (ino->localname == NULL && S_ISREG (ino->st.st_mode)
+            && ino->st.st_mode == old_ino->st.st_mode && ino->st.st_size == old_ino->st.st_size
+            && ino->st.st_mtime == old_ino->st.st_mtime && ino->st.st_mtime % 60 != 0)
+        {
+            ino->localname = old_ino->localname;
+            old_ino->localname = NULL;
+        }
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
 static struct vfs_s_entry *
 vfs_s_find_entry_linear (struct vfs_class *me, struct vfs_s_inode *root,
                          const char *a_path, int follow, int flags)
 {
     struct vfs_s_entry *ent = NULL;
+    struct vfs_s_entry *stale = NULL;
     char *const path = g_strdup (a_path);
     struct vfs_s_entry *retval = NULL;
     GList *iter;
@@ -320,7 +562,7 @@ vfs_s_find_entry_linear (struct vfs_class *me, struct vfs_s_inode *root,
         return retval;
     }
 
-    iter = g_list_find_custom (root->subdir, path, (GCompareFunc) vfs_s_entry_compare);
+    iter = vfs_s_find_link (root, path);
     ent = iter != NULL ? (struct vfs_s_entry *) iter->data : NULL;
 
     if (ent != NULL && !MEDATA->dir_uptodate (me, ent->ino))
@@ -328,7 +570,8 @@ vfs_s_find_entry_linear (struct vfs_class *me, struct vfs_s_inode *root,
 #if 1
         vfs_print_message (_("Directory cache expired for %s"), path);
 #endif
-        vfs_s_free_entry (me, ent);
+        /* expired listing is kept until the new one is loaded */
+        stale = ent;
         ent = NULL;
     }
 
@@ -341,13 +584,30 @@ vfs_s_find_entry_linear (struct vfs_class *me, struct vfs_s_inode *root,
         if (MEDATA->dir_load (me, ino, path) == -1)
         {
             vfs_s_free_entry (me, ent);
+
+            /* reload was interrupted or connection is lost: use the expired listing */
+            if (stale != NULL && me->verrno == ECONNRESET)
+            {
+                vfs_print_message (_("Cannot reload %s, old directory listing is used"), path);
+                g_free (path);
+                return stale;
+            }
+
+            if (stale != NULL)
+                vfs_s_free_entry (me, stale);
             g_free (path);
             return NULL;
         }
 
+        if (stale != NULL)
+        {
+            vfs_s_move_local_copies (stale->ino, ino);
+            vfs_s_free_entry (me, stale);
+        }
+
         vfs_s_insert_entry (me, root, ent);
 
-        iter = g_list_find_custom (root->subdir, path, (GCompareFunc) vfs_s_entry_compare);
+        iter = vfs_s_find_link (root, path);
         ent = iter != NULL ? (struct vfs_s_entry *) iter->data : NULL;
     }
     if (ent == NULL)
@@ -410,6 +670,9 @@ vfs_s_free_super (struct vfs_class *me, struct vfs_s_super *super)
     MEDATA->supers = g_list_remove (MEDATA->supers, super);
 
     CALL (free_archive) (me, super);
+    /* inodes which are still in use (leaked) keep the arena */
+    if (super->ino_usage == 0)
+        vfs_s_free_arena (super);
 #ifdef ENABLE_VFS_NET
     vfs_path_element_free (super->path_element);
 #endif
@@ -830,7 +1093,7 @@ vfs_s_ungetlocalcopy (const vfs_path_t * vpath, const char *local, int has_chang
 
 /* --------------------------------------------------------------------------------------------- */
 
-static int
+int
 vfs_s_setctl (const vfs_path_t * vpath, int ctlop, void *arg)
 {
     vfs_path_element_t *path_element;
@@ -897,6 +1160,18 @@ vfs_s_free (vfsid id)
     vfs_s_free_super (((struct vfs_s_super *) id)->me, (struct vfs_s_super *) id);
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/** Estimate memory used by directory tree of superblock: inodes, entries and names */
+
+static size_t
+vfs_s_memusage (vfsid id)
+{
+    const struct vfs_s_super *super = (const struct vfs_s_super *) id;
+
+    return (size_t) super->ino_usage
+        * (sizeof (struct vfs_s_inode) + sizeof (struct vfs_s_entry) + VFS_S_NAME_SIZE);
+}
+
 /* --------------------------------------------------------------------------------------------- */
 
 static int
@@ -925,8 +1200,10 @@ struct vfs_s_inode *
 vfs_s_new_inode (struct vfs_class *me, struct vfs_s_super *super, struct stat *initstat)
 {
     struct vfs_s_inode *ino;
+    struct vfs_s_arena *arena;
 
-    ino = g_try_new0 (struct vfs_s_inode, 1);
+    arena = vfs_s_get_arena (super);
+    ino = (struct vfs_s_inode *) vfs_s_pool_alloc (arena, &arena->inodes);
     if (ino == NULL)
         return NULL;
 
@@ -951,8 +1228,13 @@ struct vfs_s_entry *
 vfs_s_new_entry (struct vfs_class *me, const char *name, struct vfs_s_inode *inode)
 {
     struct vfs_s_entry *entry;
+    struct vfs_s_arena *arena;
 
-    entry = g_new0 (struct vfs_s_entry, 1);
+    /* entry is allocated in the same arena as its inode */
+    arena = vfs_s_get_arena (inode->super);
+    entry = (struct vfs_s_entry *) vfs_s_pool_alloc (arena, &arena->entries);
+    if (entry == NULL)
+        vfs_die ("Cannot allocate directory entry");
     total_entries++;
 
     entry->name = g_strdup (name);
@@ -969,20 +1251,24 @@ vfs_s_new_entry (struct vfs_class *me, const char *name, struct vfs_s_inode *ino
 void
 vfs_s_free_entry (struct vfs_class *me, struct vfs_s_entry *ent)
 {
+    struct vfs_s_arena *arena;
+
     if (ent->dir != NULL)
-        ent->dir->subdir = g_list_remove (ent->dir->subdir, ent);
+        vfs_s_remove_link (ent->dir, ent);
 
     g_free (ent->name);
     /* ent->name = NULL; */
 
+    total_entries--;
+
     if (ent->ino != NULL)
     {
+        arena = ent->ino->super->arena;
         ent->ino->ent = NULL;
         vfs_s_free_inode (me, ent->ino);
+        vfs_s_pool_free (&arena->entries, ent);
     }
-
-    total_entries--;
-    g_free (ent);
+    /* else entry isn't reused, it is released together with arena */
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -995,7 +1281,16 @@ vfs_s_insert_entry (struct vfs_class *me, struct vfs_s_inode *dir, struct vfs_s_
     ent->dir = dir;
 
     ent->ino->st.st_nlink++;
-    dir->subdir = g_list_append (dir->subdir, ent);
+
+    /* g_list_append() would walk the whole list */
+    dir->subdir_last = g_list_append (dir->subdir_last, ent);
+    if (dir->subdir == NULL)
+        dir->subdir = dir->subdir_last;
+    else
+        dir->subdir_last = g_list_next (dir->subdir_last);
+
+    if (dir->subdir_index != NULL)
+        vfs_s_index_add (dir, dir->subdir_last);
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -1398,6 +1693,7 @@ vfs_s_init_class (struct vfs_class *vclass, struct vfs_s_subclass *sub)
     vclass->getid = vfs_s_getid;
     vclass->nothingisopen = vfs_s_nothingisopen;
     vclass->free = vfs_s_free;
+    vclass->memusage = vfs_s_memusage;
     if (sub->flags & VFS_S_REMOTE)
     {
         vclass->getlocalcopy = vfs_s_getlocalcopy;
@@ -1456,73 +1752,166 @@ vfs_s_select_on_two (int fd1, int fd2)
 
 /* --------------------------------------------------------------------------------------------- */
 
+/**
+ * Read the next portion of data to the buffer of reader.
+ * Buffer is refilled only when all its data is consumed.
+ */
+
+static ssize_t
+vfs_s_reader_fill (vfs_s_reader_t * reader)
+{
+    ssize_t n;
+
+    n = read (reader->fd, reader->buf, sizeof (reader->buf));
+    reader->pos = 0;
+    reader->len = n > 0 ? (size_t) n : 0;
+    return n;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+vfs_s_reader_t *
+vfs_s_reader_new (int fd)
+{
+    vfs_s_reader_t *reader;
+
+    reader = g_new (vfs_s_reader_t, 1);
+    vfs_s_reader_reset (reader, fd);
+    return reader;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Attach reader to the new descriptor. Data buffered from the old one is dropped.
+ */
+
+void
+vfs_s_reader_reset (vfs_s_reader_t * reader, int fd)
+{
+    reader->fd = fd;
+    reader->pos = 0;
+    reader->len = 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+void
+vfs_s_reader_free (vfs_s_reader_t * reader)
+{
+    g_free (reader);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Read binary data. Buffered data is returned first, then data is read from
+ * the descriptor directly, without copying it through the buffer.
+ *
+ * @return number of read bytes, 0 on EOF, -1 on error (errno is set)
+ */
+
+ssize_t
+vfs_s_reader_read (vfs_s_reader_t * reader, void *buf, size_t len)
+{
+    size_t n;
+
+    if (reader->pos == reader->len)
+        return read (reader->fd, buf, len);
+
+    n = MIN (len, reader->len - reader->pos);
+    memcpy (buf, reader->buf + reader->pos, n);
+    reader->pos += n;
+    return (ssize_t) n;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Read line terminated by term. Too long line is truncated and the rest of it
+ * is discarded up to newline.
+ *
+ * @return 1 if line is read, 0 on EOF or error
+ */
+
 int
-vfs_s_get_line (struct vfs_class *me, int sock, char *buf, int buf_len, char term)
+vfs_s_get_line (struct vfs_class *me, vfs_s_reader_t * reader, char *buf, int buf_len, char term)
 {
     FILE *logfile = MEDATA->logfile;
-    int i;
-    char c;
+    int i = 0;
+    int ret = 0;
 
-    for (i = 0; i < buf_len - 1; i++, buf++)
+    while (reader->pos < reader->len || vfs_s_reader_fill (reader) > 0)
     {
-        if (read (sock, buf, sizeof (char)) <= 0)
-            return 0;
-        if (logfile)
+        char c;
+
+        c = reader->buf[reader->pos++];
+        if (logfile != NULL)
+            fputc (c, logfile);
+
+        if (i < 0)
         {
-            size_t ret1;
-            int ret2;
-            ret1 = fwrite (buf, 1, 1, logfile);
-            ret2 = fflush (logfile);
+            /* discard the rest of too long line */
+            if (c == '\n')
+            {
+                ret = 1;
+                break;
+            }
         }
-        if (*buf == term)
+        else if (c == term)
         {
-            *buf = 0;
-            return 1;
+            ret = 1;
+            break;
         }
-    }
-
-    /* Line is too long - terminate buffer and discard the rest of line */
-    *buf = 0;
-    while (read (sock, &c, sizeof (c)) > 0)
-    {
-        if (logfile)
+        else
         {
-            size_t ret1;
-            int ret2;
-            ret1 = fwrite (&c, 1, 1, logfile);
-            ret2 = fflush (logfile);
+            buf[i++] = c;
+            if (i == buf_len - 1)
+            {
+                buf[i] = '\0';
+                i = -1;
+            }
         }
-        if (c == '\n')
-            return 1;
     }
-    return 0;
+
+    if (i >= 0)
+        buf[i] = '\0';
+
+    if (logfile != NULL)
+        fflush (logfile);
+
+    return ret;
 }
 
 /* --------------------------------------------------------------------------------------------- */
 
 int
-vfs_s_get_line_interruptible (struct vfs_class *me, char *buffer, int size, int fd)
+vfs_s_get_line_interruptible (struct vfs_class *me, char *buffer, int size,
+                              vfs_s_reader_t * reader)
 {
-    int n;
     int i;
 
     (void) me;
 
-    tty_enable_interrupt_key ();
     for (i = 0; i < size - 1; i++)
     {
-        n = read (fd, buffer + i, 1);
-        tty_disable_interrupt_key ();
-        if (n == -1 && errno == EINTR)
-        {
-            buffer[i] = 0;
-            return EINTR;
-        }
-        if (n == 0)
+        if (reader->pos == reader->len)
         {
-            buffer[i] = 0;
-            return 0;
+            ssize_t n;
+
+            tty_enable_interrupt_key ();
+            n = vfs_s_reader_fill (reader);
+            tty_disable_interrupt_key ();
+            if (n == -1 && errno == EINTR)
+            {
+                buffer[i] = 0;
+                return EINTR;
+            }
+            if (n <= 0)
+            {
+                buffer[i] = 0;
+                return 0;
+            }
         }
+
+        buffer[i] = reader->buf[reader->pos++];
         if (buffer[i] == '\n')
         {
             buffer[i] = 0;
@@ -1544,6 +1933,9 @@ vfs_s_normalize_filename_leading_spaces (struct vfs_s_inode *root_inode, size_t
 {
     GList *iter;
 
+    /* names are changed, so the index is built again when needed */
+    vfs_s_index_free (root_inode);
+
     for (iter = root_inode->subdir; iter != NULL; iter = g_list_next (iter))
     {
         struct vfs_s_entry *entry = (struct vfs_s_entry *) iter->data;
@@ -55,6 +55,9 @@
 
 int vfs_timeout = 60;           /* VFS timeout in seconds */
 
+/* Memory limit of not used filesystems in megabytes, 0 means no limit */
+int vfs_memory_limit = 64;
+
 /*** file scope macro definitions ****************************************************************/
 
 /*** file scope type declarations ****************************************************************/
@@ -113,6 +116,99 @@ timeoutcmp (struct timeval *t1, struct timeval *t2)
             || ((t1->tv_sec == t2->tv_sec) && (t1->tv_usec <= t2->tv_usec)));
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Return memory used by not used filesystems which report it.
+ * newest is set to the most recently used of them.
+ */
+
+static size_t
+vfs_stamps_memusage (struct vfs_stamping **newest)
+{
+    struct vfs_stamping *stamp;
+    size_t total = 0;
+
+    *newest = NULL;
+
+    for (stamp = stamps; stamp != NULL; stamp = stamp->next)
+        if (stamp->v->memusage != NULL)
+        {
+            total += stamp->v->memusage (stamp->id);
+            if (*newest == NULL || timeoutcmp (&(*newest)->time, &stamp->time))
+                *newest = stamp;
+        }
+
+    return total;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Return least recently used filesystem which reports used memory, except newest.
+ */
+
+static struct vfs_stamping *
+vfs_stamps_lru (const struct vfs_stamping *newest)
+{
+    struct vfs_stamping *stamp;
+    struct vfs_stamping *lru = NULL;
+
+    for (stamp = stamps; stamp != NULL; stamp = stamp->next)
+        if (stamp->v->memusage != NULL && stamp != newest
+            && (lru == NULL || timeoutcmp (&stamp->time, &lru->time)))
+            lru = stamp;
+
+    return lru;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Return TRUE if not used filesystems take more memory than vfs_memory_limit
+ * and some of them can be freed.
+ */
+
+static gboolean
+vfs_memory_over_limit (void)
+{
+    struct vfs_stamping *newest;
+
+    return (vfs_memory_limit > 0
+            && vfs_stamps_memusage (&newest) > (size_t) vfs_memory_limit * 1024 * 1024
+            && vfs_stamps_lru (newest) != NULL);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Free least recently used filesystems while not used filesystems take more
+ * memory than vfs_memory_limit.
+ */
+
+static void
+vfs_expire_by_memory (void)
+{
+    struct vfs_stamping *newest;
+    size_t total;
+
+    if (vfs_memory_limit <= 0)
+        return;
+
+    total = vfs_stamps_memusage (&newest);
+
+    while (total > (size_t) vfs_memory_limit * 1024 * 1024)
+    {
+        struct vfs_stamping *lru;
+
+        /* the most recently used filesystem is kept anyway */
+        lru = vfs_stamps_lru (newest);
+        if (lru == NULL)
+            break;
+
+        total -= MIN (total, lru->v->memusage (lru->id));
+        if (lru->v->free)
+            (*lru->v->free) (lru->id);
+        vfs_rmstamp (lru->v, lru->id);
+    }
+}
+
 /* --------------------------------------------------------------------------------------------- */
 /*** public functions ****************************************************************************/
 /* --------------------------------------------------------------------------------------------- */
@@ -242,20 +338,42 @@ vfs_expire (int now)
         else
             stamp = stamp->next;
     }
+
+    vfs_expire_by_memory ();
+
     locked = 0;
 }
 
 /* --------------------------------------------------------------------------------------------- */
 /*
- * Return the number of seconds remaining to the vfs timeout.
- * FIXME: The code should be improved to actually return the number of
- * seconds until the next item times out.
+ * Return the number of seconds remaining to the vfs timeout of the
+ * least recently used filesystem, 0 if there are no filesystems to free.
+ * If not used filesystems take too much memory, return 1 to free them soon.
  */
 
 int
 vfs_timeouts ()
 {
-    return stamps ? 10 : 0;
+    struct timeval lc_time;
+    struct vfs_stamping *stamp;
+    time_t first;
+
+    if (stamps == NULL)
+        return 0;
+
+    if (vfs_memory_over_limit ())
+        return 1;
+
+    first = stamps->time.tv_sec;
+    for (stamp = stamps->next; stamp != NULL; stamp = stamp->next)
+        if (stamp->time.tv_sec < first)
+            first = stamp->time.tv_sec;
+
+    gettimeofday (&lc_time, NULL);
+    first += vfs_timeout - lc_time.tv_sec;
+
+    /* timestamps have microseconds, so wait one second more */
+    return first < 0 ? 1 : (int) first + 1;
 }
 
 /* --------------------------------------------------------------------------------------------- */
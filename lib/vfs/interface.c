@@ -65,13 +65,129 @@ struct dirent *mc_readdir_result = NULL;
 
 /*** file scope macro definitions ****************************************************************/
 
+/* how many unused local copies are kept */
+#define LOCALCOPY_CACHE_MAX 16
+
 /*** file scope type declarations ****************************************************************/
 
+/* Local copy made by mc_def_getlocalcopy() */
+typedef struct
+{
+    char *pathname;             /* VFS file */
+    char *local;                /* local file */
+    off_t size;                 /* size and mtime of VFS file when copy was made */
+    time_t mtime;
+    time_t local_mtime;         /* mtime of local file to detect its modification */
+    int ref;                    /* number of users */
+    gboolean changed;           /* copy is modified, it is kept for its users only */
+} localcopy_t;
+
 /*** file scope variables ************************************************************************/
 
+/* local copies, most recently used first */
+static GList *localcopies = NULL;
+
 /*** file scope functions ************************************************************************/
 /* --------------------------------------------------------------------------------------------- */
 
+static void
+localcopy_free (localcopy_t * lc, gboolean remove_file)
+{
+    if (remove_file)
+        unlink (lc->local);
+    g_free (lc->pathname);
+    g_free (lc->local);
+    g_free (lc);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static localcopy_t *
+localcopy_find (const char *local)
+{
+    GList *iter;
+
+    for (iter = localcopies; iter != NULL; iter = g_list_next (iter))
+    {
+        localcopy_t *lc = (localcopy_t *) iter->data;
+
+        if (strcmp (lc->local, local) == 0)
+            return lc;
+    }
+
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Find valid copy of file with given stat. Outdated unused copies are removed.
+ */
+
+static localcopy_t *
+localcopy_lookup (const char *pathname, const struct stat *st)
+{
+    GList *iter, *next;
+
+    for (iter = localcopies; iter != NULL; iter = next)
+    {
+        localcopy_t *lc = (localcopy_t *) iter->data;
+        struct stat local_st;
+
+        next = g_list_next (iter);
+
+        if (lc->changed || strcmp (lc->pathname, pathname) != 0)
+            continue;
+
+        if (lc->size == st->st_size && lc->mtime == st->st_mtime
+            && stat (lc->local, &local_st) == 0
+            && local_st.st_size == lc->size && local_st.st_mtime == lc->local_mtime)
+        {
+            /* move to the head */
+            localcopies = g_list_delete_link (localcopies, iter);
+            localcopies = g_list_prepend (localcopies, lc);
+            return lc;
+        }
+
+        if (lc->ref == 0)
+        {
+            localcopies = g_list_delete_link (localcopies, iter);
+            localcopy_free (lc, TRUE);
+        }
+    }
+
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/** Remove least recently used copies over the limit */
+
+static void
+localcopy_trim (void)
+{
+    GList *iter, *next;
+    int unused = 0;
+
+    for (iter = localcopies; iter != NULL; iter = next)
+    {
+        localcopy_t *lc = (localcopy_t *) iter->data;
+
+        next = g_list_next (iter);
+
+        if (lc->ref == 0 && ++unused > LOCALCOPY_CACHE_MAX)
+        {
+            localcopies = g_list_delete_link (localcopies, iter);
+            localcopy_free (lc, TRUE);
+        }
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Copy VFS file to temporary local file.  Copies are kept after
+ * mc_def_ungetlocalcopy() and reused while size and mtime of file are not changed,
+ * so the same file opened again or by several users is fetched once.
+ */
+
 static char *
 mc_def_getlocalcopy (const char *filename)
 {
@@ -80,6 +196,19 @@ mc_def_getlocalcopy (const char *filename)
     ssize_t i;
     char buffer[8192];
     struct stat mystat;
+    gboolean have_stat;
+    localcopy_t *lc;
+
+    have_stat = (mc_stat (filename, &mystat) != -1);
+    if (have_stat)
+    {
+        lc = localcopy_lookup (filename, &mystat);
+        if (lc != NULL)
+        {
+            lc->ref++;
+            return g_strdup (lc->local);
+        }
+    }
 
     fdin = mc_open (filename, O_RDONLY | O_LINEAR);
     if (fdin == -1)
@@ -106,9 +235,27 @@ mc_def_getlocalcopy (const char *filename)
         goto fail;
     }
 
-    if (mc_stat (filename, &mystat) != -1)
+    if (have_stat)
+    {
+        struct stat local_st;
+
         chmod (tmp, mystat.st_mode);
 
+        if (stat (tmp, &local_st) == 0 && local_st.st_size == mystat.st_size)
+        {
+            lc = g_new (localcopy_t, 1);
+            lc->pathname = g_strdup (filename);
+            lc->local = g_strdup (tmp);
+            lc->size = mystat.st_size;
+            lc->mtime = mystat.st_mtime;
+            lc->local_mtime = local_st.st_mtime;
+            lc->ref = 1;
+            lc->changed = FALSE;
+            localcopies = g_list_prepend (localcopies, lc);
+            localcopy_trim ();
+        }
+    }
+
     return tmp;
 
   fail:
@@ -127,6 +274,41 @@ mc_def_ungetlocalcopy (struct vfs_class *vfs, const char *filename,
                        const char *local, int has_changed)
 {
     int fdin = -1, fdout = -1;
+    gboolean in_use = FALSE;
+    localcopy_t *lc;
+
+    lc = localcopy_find (local);
+    if (lc != NULL)
+    {
+        lc->ref--;
+
+        /* modified copy doesn't match the file anymore, it isn't reused */
+        if (has_changed)
+            lc->changed = TRUE;
+
+        /* other users of copy still need the file */
+        in_use = (lc->ref > 0);
+
+        if (!in_use && lc->changed)
+        {
+            localcopies = g_list_remove (localcopies, lc);
+            localcopy_free (lc, FALSE);
+        }
+        else if (!has_changed)
+        {
+            /* keep copy for the next use */
+            localcopy_trim ();
+            return 0;
+        }
+
+        if (!has_changed)
+        {
+            /* the last user of modified copy */
+            unlink (local);
+            return 0;
+        }
+    }
+
     if (has_changed)
     {
         char buffer[8192];
@@ -159,7 +341,8 @@ mc_def_ungetlocalcopy (struct vfs_class *vfs, const char *filename,
             goto failed;
         }
     }
-    unlink (local);
+    if (!in_use)
+        unlink (local);
     return 0;
 
   failed:
@@ -168,12 +351,104 @@ mc_def_ungetlocalcopy (struct vfs_class *vfs, const char *filename,
         mc_close (fdout);
     if (fdin != -1)
         close (fdin);
-    unlink (local);
+    if (!in_use)
+        unlink (local);
     return -1;
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Emulate pread/pwrite by lseek and read/write. Position of file is restored.
+ */
+
+static ssize_t
+mc_def_prw (struct vfs_class *vfs, void *fsinfo, void *buffer, size_t count, off_t offset,
+            gboolean do_write)
+{
+    off_t pos;
+    ssize_t result;
+    int saved_errno = 0;
+
+    if (vfs->lseek == NULL || (do_write ? vfs->write == NULL : vfs->read == NULL))
+    {
+        errno = E_NOTSUPP;
+        return -1;
+    }
+
+    pos = (*vfs->lseek) (fsinfo, 0, SEEK_CUR);
+    if (pos == -1 || (*vfs->lseek) (fsinfo, offset, SEEK_SET) != offset)
+    {
+        errno = vfs_ferrno (vfs);
+        return -1;
+    }
+
+    result = do_write ? (*vfs->write) (fsinfo, (const char *) buffer, count)
+        : (*vfs->read) (fsinfo, (char *) buffer, count);
+    if (result == -1)
+        saved_errno = vfs_ferrno (vfs);
+
+    (*vfs->lseek) (fsinfo, pos, SEEK_SET);
+
+    if (result == -1)
+        errno = saved_errno;
+    return result;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Emulate readv/writev by read/write of every buffer. Stop at the first short transfer.
+ */
+
+static ssize_t
+mc_def_rwv (struct vfs_class *vfs, void *fsinfo, const struct iovec *iov, int iovcnt,
+            gboolean do_write)
+{
+    ssize_t total = 0;
+    int i;
+
+    if (do_write ? vfs->write == NULL : vfs->read == NULL)
+    {
+        errno = E_NOTSUPP;
+        return -1;
+    }
+
+    for (i = 0; i < iovcnt; i++)
+    {
+        ssize_t n;
+
+        n = do_write ? (*vfs->write) (fsinfo, (const char *) iov[i].iov_base, iov[i].iov_len)
+            : (*vfs->read) (fsinfo, (char *) iov[i].iov_base, iov[i].iov_len);
+        if (n == -1)
+        {
+            if (total != 0)
+                break;
+            errno = vfs_ferrno (vfs);
+            return -1;
+        }
+
+        total += n;
+        if ((size_t) n < iov[i].iov_len)
+            break;
+    }
+
+    return total;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 /*** public functions ****************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Remove all local copies kept by mc_def_getlocalcopy().
+ */
+
+void
+vfs_localcopy_done (void)
+{
+    g_list_foreach (localcopies, (GFunc) localcopy_free, GINT_TO_POINTER (TRUE));
+    g_list_free (localcopies);
+    localcopies = NULL;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 
 int
@@ -296,10 +571,11 @@ mc_symlink (const char *name1, const char *path)
 ssize_t mc_##name inarg \
 { \
     struct vfs_class *vfs; \
+    void *fsinfo = NULL; \
     int result; \
     if (handle == -1) \
         return -1; \
-    vfs = vfs_class_find_by_handle (handle); \
+    vfs = vfs_class_find_by_handle (handle, &fsinfo); \
     if (vfs == NULL) \
         return -1; \
     result = vfs->name != NULL ? vfs->name callarg : -1; \
@@ -308,8 +584,8 @@ ssize_t mc_##name inarg \
     return result; \
 }
 
-MC_HANDLEOP (read, (int handle, void *buffer, size_t count), (vfs_class_data_find_by_handle (handle), buffer, count))
-MC_HANDLEOP (write, (int handle, const void *buf, size_t nbyte), (vfs_class_data_find_by_handle (handle), buf, nbyte))
+MC_HANDLEOP (read, (int handle, void *buffer, size_t count), (fsinfo, buffer, count))
+MC_HANDLEOP (write, (int handle, const void *buf, size_t nbyte), (fsinfo, buf, nbyte))
 
 /* --------------------------------------------------------------------------------------------- */
 
@@ -362,12 +638,14 @@ MC_RENAMEOP (rename)
 int
 mc_ctl (int handle, int ctlop, void *arg)
 {
-    struct vfs_class *vfs = vfs_class_find_by_handle (handle);
+    void *fsinfo = NULL;
+    struct vfs_class *vfs;
 
+    vfs = vfs_class_find_by_handle (handle, &fsinfo);
     if (vfs == NULL)
         return 0;
 
-    return vfs->ctl ? (*vfs->ctl) (vfs_class_data_find_by_handle (handle), ctlop, arg) : 0;
+    return vfs->ctl ? (*vfs->ctl) (fsinfo, ctlop, arg) : 0;
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -400,13 +678,14 @@ int
 mc_close (int handle)
 {
     struct vfs_class *vfs;
+    void *fsinfo = NULL;
     int result;
 
-    if (handle == -1 || !vfs_class_data_find_by_handle (handle))
+    if (handle == -1)
         return -1;
 
-    vfs = vfs_class_find_by_handle (handle);
-    if (vfs == NULL)
+    vfs = vfs_class_find_by_handle (handle, &fsinfo);
+    if (vfs == NULL || fsinfo == NULL)
         return -1;
 
     if (handle < 3)
@@ -414,7 +693,7 @@ mc_close (int handle)
 
     if (!vfs->close)
         vfs_die ("VFS must support close.\n");
-    result = (*vfs->close) (vfs_class_data_find_by_handle (handle));
+    result = (*vfs->close) (fsinfo);
     vfs_free_handle (handle);
     if (result == -1)
         errno = vfs_ferrno (vfs);
@@ -504,11 +783,10 @@ mc_readdir (DIR * dirp)
     }
     handle = *(int *) dirp;
 
-    vfs = vfs_class_find_by_handle (handle);
+    vfs = vfs_class_find_by_handle (handle, (void *) &vfs_path_element);
     if (vfs == NULL)
         return NULL;
 
-    vfs_path_element = vfs_class_data_find_by_handle (handle);
     if (vfs->readdir)
     {
         entry = (*vfs->readdir) (vfs_path_element->dir.info);
@@ -532,13 +810,12 @@ mc_closedir (DIR * dirp)
 {
     int handle = *(int *) dirp;
     struct vfs_class *vfs;
+    vfs_path_element_t *vfs_path_element;
     int result = -1;
 
-    vfs = vfs_class_find_by_handle (handle);
+    vfs = vfs_class_find_by_handle (handle, (void *) &vfs_path_element);
     if (vfs != NULL)
     {
-        vfs_path_element_t *vfs_path_element;
-        vfs_path_element = vfs_class_data_find_by_handle (handle);
         if (vfs_path_element->dir.converter != str_cnv_from_term)
         {
             str_close_conv (vfs_path_element->dir.converter);
@@ -611,16 +888,17 @@ int
 mc_fstat (int handle, struct stat *buf)
 {
     struct vfs_class *vfs;
+    void *fsinfo = NULL;
     int result;
 
     if (handle == -1)
         return -1;
 
-    vfs = vfs_class_find_by_handle (handle);
+    vfs = vfs_class_find_by_handle (handle, &fsinfo);
     if (vfs == NULL)
         return -1;
 
-    result = vfs->fstat ? (*vfs->fstat) (vfs_class_data_find_by_handle (handle), buf) : -1;
+    result = vfs->fstat ? (*vfs->fstat) (fsinfo, buf) : -1;
     if (result == -1)
         errno = vfs->name ? vfs_ferrno (vfs) : E_NOTSUPP;
     return result;
@@ -760,19 +1038,127 @@ off_t
 mc_lseek (int fd, off_t offset, int whence)
 {
     struct vfs_class *vfs;
+    void *fsinfo = NULL;
     off_t result;
 
     if (fd == -1)
         return -1;
 
-    vfs = vfs_class_find_by_handle (fd);
+    vfs = vfs_class_find_by_handle (fd, &fsinfo);
     if (vfs == NULL)
         return -1;
 
-    result = vfs->lseek ? (*vfs->lseek) (vfs_class_data_find_by_handle (fd), offset, whence) : -1;
+    result = vfs->lseek ? (*vfs->lseek) (fsinfo, offset, whence) : -1;
     if (result == -1)
         errno = vfs->lseek ? vfs_ferrno (vfs) : E_NOTSUPP;
     return result;
 }
 
 /* --------------------------------------------------------------------------------------------- */
+/**
+ * Read from given offset of file. Unlike mc_lseek() + mc_read(), position of file
+ * is not changed.
+ */
+
+ssize_t
+mc_pread (int handle, void *buffer, size_t count, off_t offset)
+{
+    struct vfs_class *vfs;
+    void *fsinfo = NULL;
+    ssize_t result;
+
+    if (handle == -1)
+        return -1;
+
+    vfs = vfs_class_find_by_handle (handle, &fsinfo);
+    if (vfs == NULL)
+        return -1;
+
+    if (vfs->pread == NULL)
+        return mc_def_prw (vfs, fsinfo, buffer, count, offset, FALSE);
+
+    result = (*vfs->pread) (fsinfo, (char *) buffer, count, offset);
+    if (result == -1)
+        errno = vfs_ferrno (vfs);
+    return result;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Write to given offset of file. Position of file is not changed.
+ */
+
+ssize_t
+mc_pwrite (int handle, const void *buffer, size_t count, off_t offset)
+{
+    struct vfs_class *vfs;
+    void *fsinfo = NULL;
+    ssize_t result;
+
+    if (handle == -1)
+        return -1;
+
+    vfs = vfs_class_find_by_handle (handle, &fsinfo);
+    if (vfs == NULL)
+        return -1;
+
+    if (vfs->pwrite == NULL)
+        return mc_def_prw (vfs, fsinfo, (void *) buffer, count, offset, TRUE);
+
+    result = (*vfs->pwrite) (fsinfo, (const char *) buffer, count, offset);
+    if (result == -1)
+        errno = vfs_ferrno (vfs);
+    return result;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+ssize_t
+mc_readv (int handle, const struct iovec *iov, int iovcnt)
+{
+    struct vfs_class *vfs;
+    void *fsinfo = NULL;
+    ssize_t result;
+
+    if (handle == -1)
+        return -1;
+
+    vfs = vfs_class_find_by_handle (handle, &fsinfo);
+    if (vfs == NULL)
+        return -1;
+
+    if (vfs->readv == NULL)
+        return mc_def_rwv (vfs, fsinfo, iov, iovcnt, FALSE);
+
+    result = (*vfs->readv) (fsinfo, iov, iovcnt);
+    if (result == -1)
+        errno = vfs_ferrno (vfs);
+    return result;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+ssize_t
+mc_writev (int handle, const struct iovec *iov, int iovcnt)
+{
+    struct vfs_class *vfs;
+    void *fsinfo = NULL;
+    ssize_t result;
+
+    if (handle == -1)
+        return -1;
+
+    vfs = vfs_class_find_by_handle (handle, &fsinfo);
+    if (vfs == NULL)
+        return -1;
+
+    if (vfs->writev == NULL)
+        return mc_def_rwv (vfs, fsinfo, iov, iovcnt, TRUE);
+
+    result = (*vfs->writev) (fsinfo, iov, iovcnt);
+    if (result == -1)
+        errno = vfs_ferrno (vfs);
+    return result;
+}
+
+/* --------------------------------------------------------------------------------------------- */
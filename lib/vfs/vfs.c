@@ -79,11 +79,12 @@ struct vfs_class *current_vfs = NULL;
 
 /*** file scope type declarations ****************************************************************/
 
+/* Slot of table of open files */
 struct vfs_openfile
 {
-    int handle;
-    struct vfs_class *vclass;
+    struct vfs_class *vclass;   /* NULL if slot is free */
     void *fsinfo;
+    int next_free;              /* index of the next free slot */
 };
 
 /*** file scope variables ************************************************************************/
@@ -91,8 +92,9 @@ struct vfs_openfile
 /** They keep track of the current directory */
 static vfs_path_t *current_path = NULL;
 
-static GPtrArray *vfs_openfiles;
-static long vfs_free_handle_list = -1;
+/* open files indexed by handle - VFS_FIRST_HANDLE */
+static GArray *vfs_openfiles;
+static int vfs_free_handle_list = -1;
 
 /*** file scope functions ************************************************************************/
 /* --------------------------------------------------------------------------------------------- */
@@ -175,7 +177,7 @@ _vfs_translate_path (const char *path, int size, GIConv defcnv, GString * buffer
 
 /* --------------------------------------------------------------------------------------------- */
 
-static struct vfs_openfile *
+static inline struct vfs_openfile *
 vfs_get_openfile (int handle)
 {
     struct vfs_openfile *h;
@@ -183,13 +185,9 @@ vfs_get_openfile (int handle)
     if (handle < VFS_FIRST_HANDLE || (guint) (handle - VFS_FIRST_HANDLE) >= vfs_openfiles->len)
         return NULL;
 
-    h = (struct vfs_openfile *) g_ptr_array_index (vfs_openfiles, handle - VFS_FIRST_HANDLE);
-    if (h == NULL)
-        return NULL;
-
-    g_assert (h->handle == handle);
+    h = &g_array_index (vfs_openfiles, struct vfs_openfile, handle - VFS_FIRST_HANDLE);
 
-    return h;
+    return h->vclass == NULL ? NULL : h;
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -199,44 +197,39 @@ vfs_get_openfile (int handle)
 
 void
 vfs_free_handle (int handle)
-{
-    const int idx = handle - VFS_FIRST_HANDLE;
-
-    if (handle >= VFS_FIRST_HANDLE && (guint) idx < vfs_openfiles->len)
-    {
-        struct vfs_openfile *h;
-
-        h = (struct vfs_openfile *) g_ptr_array_index (vfs_openfiles, idx);
-        g_free (h);
-        g_ptr_array_index (vfs_openfiles, idx) = (void *) vfs_free_handle_list;
-        vfs_free_handle_list = idx;
-    }
-}
-
-
-/* --------------------------------------------------------------------------------------------- */
-/** Find private file data by file handle */
-
-void *
-vfs_class_data_find_by_handle (int handle)
 {
     struct vfs_openfile *h;
 
     h = vfs_get_openfile (handle);
-
-    return h == NULL ? NULL : h->fsinfo;
+    if (h != NULL)
+    {
+        h->vclass = NULL;
+        h->fsinfo = NULL;
+        h->next_free = vfs_free_handle_list;
+        vfs_free_handle_list = handle - VFS_FIRST_HANDLE;
+    }
 }
 
 /* --------------------------------------------------------------------------------------------- */
-/** Find VFS class by file handle */
+/**
+ * Find VFS class and private file data by file handle
+ *
+ * @param handle file handle
+ * @param fsinfo if not NULL, private data of file is stored here
+ *
+ * @return class of file, NULL if handle is not valid
+ */
 
 struct vfs_class *
-vfs_class_find_by_handle (int handle)
+vfs_class_find_by_handle (int handle, void **fsinfo)
 {
     struct vfs_openfile *h;
 
     h = vfs_get_openfile (handle);
 
+    if (fsinfo != NULL)
+        *fsinfo = h == NULL ? NULL : h->fsinfo;
+
     return h == NULL ? NULL : h->vclass;
 }
 
@@ -250,27 +243,26 @@ int
 vfs_new_handle (struct vfs_class *vclass, void *fsinfo)
 {
     struct vfs_openfile *h;
-
-    h = g_new (struct vfs_openfile, 1);
-    h->fsinfo = fsinfo;
-    h->vclass = vclass;
+    int idx;
 
     /* Allocate the first free handle */
-    h->handle = vfs_free_handle_list;
-    if (h->handle == -1)
+    idx = vfs_free_handle_list;
+    if (idx == -1)
     {
         /* No free allocated handles, allocate one */
-        h->handle = vfs_openfiles->len;
-        g_ptr_array_add (vfs_openfiles, h);
-    }
-    else
-    {
-        vfs_free_handle_list = (long) g_ptr_array_index (vfs_openfiles, vfs_free_handle_list);
-        g_ptr_array_index (vfs_openfiles, h->handle) = h;
+        idx = vfs_openfiles->len;
+        g_array_set_size (vfs_openfiles, idx + 1);
     }
 
-    h->handle += VFS_FIRST_HANDLE;
-    return h->handle;
+    h = &g_array_index (vfs_openfiles, struct vfs_openfile, idx);
+    if (idx == vfs_free_handle_list)
+        vfs_free_handle_list = h->next_free;
+
+    h->vclass = vclass;
+    h->fsinfo = fsinfo;
+    h->next_free = -1;
+
+    return idx + VFS_FIRST_HANDLE;
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -425,7 +417,7 @@ vfs_init (void)
     vfs__classes_list = g_ptr_array_new ();
 
     /* create the VFS handle array */
-    vfs_openfiles = g_ptr_array_new ();
+    vfs_openfiles = g_array_new (FALSE, TRUE, sizeof (struct vfs_openfile));
 
     vfs_str_buffer = g_string_new ("");
 
@@ -458,6 +450,7 @@ vfs_shut (void)
     guint i;
 
     vfs_gc_done ();
+    vfs_localcopy_done ();
 
     vfs_set_raw_current_dir (NULL);
 
@@ -469,7 +462,7 @@ vfs_shut (void)
             vfs->done (vfs);
     }
 
-    g_ptr_array_free (vfs_openfiles, TRUE);
+    g_array_free (vfs_openfiles, TRUE);
     g_ptr_array_free (vfs__classes_list, TRUE);
     g_string_free (vfs_str_buffer, TRUE);
     g_free (mc_readdir_result);
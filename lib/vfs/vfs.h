@@ -9,6 +9,7 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>            /* struct iovec */
 #include <dirent.h>
 #include <utime.h>
 #include <stdio.h>
@@ -122,7 +123,16 @@ enum
 
     /* Setting this makes vfs layer give out potentially incorrect data,
        but it also makes some operations much faster. Use with caution. */
-    VFS_SETCTL_STALE_DATA
+    VFS_SETCTL_STALE_DATA,
+
+    /* Files of directory (GPtrArray of names) are going to be read, so they
+       can be fetched at once instead of one by one */
+    VFS_SETCTL_PREFETCH,
+
+    /* Files of directory (GPtrArray of names) are deleted at once, unlink of every
+       file returns its result then. Returns 1 if files were deleted.
+       NULL ends the operation */
+    VFS_SETCTL_BATCH_UNLINK
 };
 
 /*** structures declarations (and typedefs of structures)*****************************************/
@@ -154,6 +164,11 @@ typedef struct vfs_class
     int (*close) (void *vfs_info);
       ssize_t (*read) (void *vfs_info, char *buffer, size_t count);
       ssize_t (*write) (void *vfs_info, const char *buf, size_t count);
+    /* positional and vectored I/O, emulated by read/write/lseek if NULL */
+      ssize_t (*pread) (void *vfs_info, char *buffer, size_t count, off_t offset);
+      ssize_t (*pwrite) (void *vfs_info, const char *buf, size_t count, off_t offset);
+      ssize_t (*readv) (void *vfs_info, const struct iovec * iov, int iovcnt);
+      ssize_t (*writev) (void *vfs_info, const struct iovec * iov, int iovcnt);
 
     void *(*opendir) (const vfs_path_t * vpath);
     void *(*readdir) (void *vfs_info);
@@ -181,6 +196,8 @@ typedef struct vfs_class
 
     int (*nothingisopen) (vfsid id);
     void (*free) (vfsid id);
+    /* approximate amount of memory used by filesystem, 0 if unknown */
+      size_t (*memusage) (vfsid id);
 
     char *(*getlocalcopy) (const vfs_path_t * vpath);
     int (*ungetlocalcopy) (const vfs_path_t * vpath, const char *local, int has_changed);
@@ -205,6 +222,7 @@ union vfs_dirent
 /*** global variables defined in .c file *********************************************************/
 
 extern int vfs_timeout;
+extern int vfs_memory_limit;
 
 #ifdef ENABLE_VFS_NET
 extern int use_netrc;
@@ -258,9 +276,7 @@ int vfs_ferrno (struct vfs_class *vfs);
 
 int vfs_new_handle (struct vfs_class *vclass, void *fsinfo);
 
-struct vfs_class *vfs_class_find_by_handle (int handle);
-
-void *vfs_class_data_find_by_handle (int handle);
+struct vfs_class *vfs_class_find_by_handle (int handle, void **fsinfo);
 
 void vfs_free_handle (int handle);
 
@@ -270,11 +286,17 @@ vfs_path_t *vfs_change_encoding (vfs_path_t * vpath, const char *encoding);
 
 int vfs_preallocate (int dest_desc, off_t src_fsize, off_t dest_fsize);
 
+void vfs_localcopy_done (void);
+
 /**
  * Interface functions described in interface.c
  */
 ssize_t mc_read (int handle, void *buffer, size_t count);
 ssize_t mc_write (int handle, const void *buffer, size_t count);
+ssize_t mc_pread (int handle, void *buffer, size_t count, off_t offset);
+ssize_t mc_pwrite (int handle, const void *buffer, size_t count, off_t offset);
+ssize_t mc_readv (int handle, const struct iovec *iov, int iovcnt);
+ssize_t mc_writev (int handle, const struct iovec *iov, int iovcnt);
 int mc_utime (const char *path, struct utimbuf *times);
 int mc_readlink (const char *path, char *buf, size_t bufsiz);
 int mc_close (int handle);
@@ -63,6 +63,7 @@ struct vfs_s_super
     int fd_usage;               /* Number of open files */
     int ino_usage;              /* Usage count of this superblock */
     int want_stale;             /* If set, we do not flush cache properly */
+    struct vfs_s_arena *arena;  /* memory of inodes and entries */
 #ifdef ENABLE_VFS_NET
     vfs_path_element_t *path_element;
 #endif                          /* ENABLE_VFS_NET */
@@ -70,6 +71,15 @@ struct vfs_s_super
     void *data;                 /* This is for filesystem-specific use */
 };
 
+/* Buffered reader of socket or pipe of network filesystem */
+typedef struct
+{
+    int fd;
+    size_t pos;                 /* first unread byte of buf */
+    size_t len;                 /* number of bytes in buf */
+    char buf[BUF_8K];
+} vfs_s_reader_t;
+
 /*
  * Single virtual file - directory entry.  The same inode can have many
  * entries (i.e. hard links), but usually has only one.
@@ -89,6 +99,9 @@ struct vfs_s_inode
                                    use only for directories because they
                                    cannot be hardlinked */
     GList *subdir;              /* If this is a directory, its entry. List of vfs_s_entry */
+    GList *subdir_last;         /* Last link of subdir */
+    GHashTable *subdir_index;   /* Name -> link of subdir, only for big directories */
+    int subdir_dups;            /* Number of entries not in index because of duplicated names */
     struct stat st;             /* Parameters of this inode */
     char *linkname;             /* Symlink's contents */
     char *localname;            /* Filename of local file, if we have one */
@@ -170,14 +183,21 @@ struct vfs_s_inode *vfs_s_find_root (struct vfs_class *me, struct vfs_s_entry *e
 /* outside interface */
 void vfs_s_init_class (struct vfs_class *vclass, struct vfs_s_subclass *sub);
 const char *vfs_s_get_path (const vfs_path_t * vpath, struct vfs_s_super **archive, int flags);
+int vfs_s_setctl (const vfs_path_t * vpath, int ctlop, void *arg);
 
 void vfs_s_invalidate (struct vfs_class *me, struct vfs_s_super *super);
 char *vfs_s_fullpath (struct vfs_class *me, struct vfs_s_inode *ino);
 
 /* network filesystems support */
 int vfs_s_select_on_two (int fd1, int fd2);
-int vfs_s_get_line (struct vfs_class *me, int sock, char *buf, int buf_len, char term);
-int vfs_s_get_line_interruptible (struct vfs_class *me, char *buffer, int size, int fd);
+vfs_s_reader_t *vfs_s_reader_new (int fd);
+void vfs_s_reader_reset (vfs_s_reader_t * reader, int fd);
+void vfs_s_reader_free (vfs_s_reader_t * reader);
+ssize_t vfs_s_reader_read (vfs_s_reader_t * reader, void *buf, size_t len);
+int vfs_s_get_line (struct vfs_class *me, vfs_s_reader_t * reader, char *buf, int buf_len,
+                    char term);
+int vfs_s_get_line_interruptible (struct vfs_class *me, char *buffer, int size,
+                                  vfs_s_reader_t * reader);
 /* misc */
 int vfs_s_retrieve_file (struct vfs_class *me, struct vfs_s_inode *ino);
 
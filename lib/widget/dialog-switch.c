@@ -167,6 +167,17 @@ dialog_switch_num (void)
     return g_list_length (mc_dialogs);
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Call func for each dialog of the screen list: filemanagers, editors, viewers
+ */
+
+void
+dialog_switch_foreach (GFunc func, gpointer user_data)
+{
+    g_list_foreach (mc_dialogs, func, user_data);
+}
+
 /* --------------------------------------------------------------------------------------------- */
 
 void
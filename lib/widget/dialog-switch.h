@@ -19,6 +19,7 @@ extern Dlg_head *midnight_dlg;
 void dialog_switch_add (struct Dlg_head *h);
 void dialog_switch_remove (struct Dlg_head *h);
 size_t dialog_switch_num (void);
+void dialog_switch_foreach (GFunc func, gpointer user_data);
 
 void dialog_switch_next (void);
 void dialog_switch_prev (void);
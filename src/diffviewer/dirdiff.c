@@ -0,0 +1,517 @@
+/*
+   Recursive comparison of directory trees for the diff viewer
+
+   Copyright (C) 2011
+   The Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** \file
+ *  \brief Source: recursive comparison of directory trees
+ *
+ *  Both trees are walked in parallel one directory at a time: entries of the
+ *  directory of the first tree are put into a hash table by name, and entries
+ *  of the same directory of the second tree are looked up there.  Only
+ *  directories existing in both trees are descended into and only found
+ *  differences are kept, so memory doesn't depend on the size of the trees.
+ *
+ *  Regular files are compared by size and modification time first.  Contents
+ *  is read only if sizes are equal and times differ, and reading stops at the
+ *  first different block.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "lib/global.h"
+#include "lib/tty/tty.h"
+#include "lib/strutil.h"
+#include "lib/vfs/vfs.h"
+#include "lib/util.h"
+#include "lib/widget.h"
+
+#include "internal.h"
+
+/*** global variables ****************************************************************************/
+
+/*** file scope macro definitions ****************************************************************/
+
+#define DIRDIFF_BLOCK_SIZE (64 * 1024)
+
+/*** file scope type declarations ****************************************************************/
+
+typedef enum
+{
+    DIRDIFF_ONLY_LEFT = 0,
+    DIRDIFF_ONLY_RIGHT,
+    DIRDIFF_TYPE,               /* file in one tree, directory in other one, etc */
+    DIRDIFF_SIZE,
+    DIRDIFF_CONTENT,
+    DIRDIFF_TIME                /* contents is the same, modification time isn't */
+} dirdiff_kind_t;
+
+/* result of comparison of file contents */
+typedef enum
+{
+    DIRDIFF_SAME = 0,
+    DIRDIFF_DIFFER,
+    DIRDIFF_INTERRUPTED
+} dirdiff_contents_t;
+
+typedef struct
+{
+    char *path;                 /* relative to the compared directories */
+    dirdiff_kind_t kind;
+    gboolean is_file;           /* regular file in both trees */
+} dirdiff_entry_t;
+
+typedef struct
+{
+    const char *rel;
+    GPtrArray *result;
+} dirdiff_scan_t;
+
+/*** file scope variables ************************************************************************/
+
+/* marks of dirdiff_kind_t */
+static const char dirdiff_marks[] = "<>!SCT";
+
+/*** file scope functions ************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+dirdiff_add (GPtrArray * result, const char *path, dirdiff_kind_t kind, gboolean is_file)
+{
+    dirdiff_entry_t *e;
+
+    e = g_new (dirdiff_entry_t, 1);
+    e->path = g_strdup (path);
+    e->kind = kind;
+    e->is_file = is_file;
+    g_ptr_array_add (result, e);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+dirdiff_entry_free (gpointer data, gpointer user_data)
+{
+    dirdiff_entry_t *e = (dirdiff_entry_t *) data;
+
+    (void) user_data;
+
+    g_free (e->path);
+    g_free (e);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static char *
+dirdiff_path (const char *rel, const char *name)
+{
+    return rel[0] == '\0' ? g_strdup (name) : concat_dir_and_file (rel, name);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/** Add entry which is not found in the second directory */
+
+static void
+dirdiff_add_only_left (gpointer key, gpointer value, gpointer user_data)
+{
+    dirdiff_scan_t *scan = (dirdiff_scan_t *) user_data;
+    char *path;
+
+    (void) value;
+
+    path = dirdiff_path (scan->rel, (const char *) key);
+    dirdiff_add (scan->result, path, DIRDIFF_ONLY_LEFT, FALSE);
+    g_free (path);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+dirdiff_entry_cmp (gconstpointer a, gconstpointer b)
+{
+    const dirdiff_entry_t *ea = *(const dirdiff_entry_t * const *) a;
+    const dirdiff_entry_t *eb = *(const dirdiff_entry_t * const *) b;
+
+    return strcmp (ea->path, eb->path);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static ssize_t
+dirdiff_read_block (int fd, char *buf)
+{
+    ssize_t n = 0;
+
+    while (n < DIRDIFF_BLOCK_SIZE)
+    {
+        ssize_t r;
+
+        r = mc_read (fd, buf + n, DIRDIFF_BLOCK_SIZE - n);
+        if (r == -1 && errno == EINTR)
+            continue;
+        if (r < 0)
+            return -1;
+        if (r == 0)
+            break;
+        n += r;
+    }
+
+    return n;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Compare contents of two files of the same size block by block.
+ *
+ * @return DIRDIFF_SAME if files are equal, DIRDIFF_DIFFER if they differ or can't be read,
+ *         DIRDIFF_INTERRUPTED if comparison was interrupted by user
+ */
+
+static dirdiff_contents_t
+dirdiff_same_contents (const char *name0, const char *name1)
+{
+    int fd0, fd1;
+    char *buf;
+    dirdiff_contents_t res = DIRDIFF_DIFFER;
+
+    fd0 = mc_open (name0, O_RDONLY);
+    if (fd0 == -1)
+        return DIRDIFF_DIFFER;
+
+    fd1 = mc_open (name1, O_RDONLY);
+    if (fd1 == -1)
+    {
+        mc_close (fd0);
+        return DIRDIFF_DIFFER;
+    }
+
+    buf = g_malloc (2 * DIRDIFF_BLOCK_SIZE);
+
+    while (TRUE)
+    {
+        ssize_t n0, n1;
+
+        /* tty_got_interrupt() resets the flag, so the caller must be told about it */
+        if (tty_got_interrupt ())
+        {
+            res = DIRDIFF_INTERRUPTED;
+            break;
+        }
+
+        n0 = dirdiff_read_block (fd0, buf);
+        n1 = dirdiff_read_block (fd1, buf + DIRDIFF_BLOCK_SIZE);
+        if (n0 < 0 || n0 != n1 || memcmp (buf, buf + DIRDIFF_BLOCK_SIZE, n0) != 0)
+            break;
+        if (n0 < DIRDIFF_BLOCK_SIZE)
+        {
+            res = DIRDIFF_SAME;
+            break;
+        }
+    }
+
+    g_free (buf);
+    mc_close (fd1);
+    mc_close (fd0);
+
+    return res;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+dirdiff_same_links (const char *name0, const char *name1)
+{
+    char link0[MC_MAXPATHLEN], link1[MC_MAXPATHLEN];
+    int len0, len1;
+
+    len0 = mc_readlink (name0, link0, sizeof (link0));
+    len1 = mc_readlink (name1, link1, sizeof (link1));
+
+    return (len0 >= 0 && len0 == len1 && memcmp (link0, link1, len0) == 0);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Compare entries existing in both trees.
+ * If comparison of contents is interrupted, the pair of entries isn't classified.
+ *
+ * @return TRUE if both entries are directories
+ */
+
+static gboolean
+dirdiff_compare_entries (const char *rel, const char *name0, const struct stat *st0,
+                         const char *name1, const struct stat *st1, GPtrArray * result,
+                         gboolean * interrupted)
+{
+    if ((st0->st_mode & S_IFMT) != (st1->st_mode & S_IFMT))
+        dirdiff_add (result, rel, DIRDIFF_TYPE, FALSE);
+    else if (S_ISDIR (st0->st_mode))
+        return TRUE;
+    else if (S_ISREG (st0->st_mode))
+    {
+        if (st0->st_size != st1->st_size)
+            dirdiff_add (result, rel, DIRDIFF_SIZE, TRUE);
+        else if (st0->st_mtime != st1->st_mtime)
+            switch (dirdiff_same_contents (name0, name1))
+            {
+            case DIRDIFF_SAME:
+                dirdiff_add (result, rel, DIRDIFF_TIME, TRUE);
+                break;
+            case DIRDIFF_DIFFER:
+                dirdiff_add (result, rel, DIRDIFF_CONTENT, TRUE);
+                break;
+            default:
+                *interrupted = TRUE;
+                break;
+            }
+    }
+    else if (S_ISLNK (st0->st_mode) && !dirdiff_same_links (name0, name1))
+        dirdiff_add (result, rel, DIRDIFF_CONTENT, FALSE);
+
+    return FALSE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Compare directory rel of both trees and its subdirectories.
+ *
+ * @return FALSE if comparison was interrupted
+ */
+
+static gboolean
+dirdiff_scan (const char *root0, const char *root1, const char *rel, GPtrArray * result)
+{
+    char *dir0, *dir1;
+    DIR *d;
+    struct dirent *de;
+    GHashTable *names;
+    GPtrArray *subdirs;
+    dirdiff_scan_t scan;
+    guint i;
+    gboolean ok = TRUE;
+    gboolean interrupted = FALSE;
+
+    dir0 = concat_dir_and_file (root0, rel);
+    dir1 = concat_dir_and_file (root1, rel);
+
+    /* name -> struct stat of entries of the first directory */
+    names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+    d = mc_opendir (dir0);
+    if (d != NULL)
+    {
+        while ((de = mc_readdir (d)) != NULL)
+        {
+            struct stat st;
+            char *name;
+
+            if (strcmp (de->d_name, ".") == 0 || strcmp (de->d_name, "..") == 0)
+                continue;
+
+            name = concat_dir_and_file (dir0, de->d_name);
+            if (mc_lstat (name, &st) == 0)
+                g_hash_table_insert (names, g_strdup (de->d_name), g_memdup (&st, sizeof (st)));
+            g_free (name);
+        }
+        mc_closedir (d);
+    }
+
+    subdirs = g_ptr_array_new ();
+
+    d = mc_opendir (dir1);
+    if (d != NULL)
+    {
+        while (ok && (de = mc_readdir (d)) != NULL)
+        {
+            struct stat st1;
+            const struct stat *st0;
+            char *name0, *name1, *path;
+
+            if (strcmp (de->d_name, ".") == 0 || strcmp (de->d_name, "..") == 0)
+                continue;
+
+            name1 = concat_dir_and_file (dir1, de->d_name);
+            if (mc_lstat (name1, &st1) != 0)
+            {
+                g_free (name1);
+                continue;
+            }
+
+            path = dirdiff_path (rel, de->d_name);
+
+            st0 = (const struct stat *) g_hash_table_lookup (names, de->d_name);
+            if (st0 == NULL)
+                dirdiff_add (result, path, DIRDIFF_ONLY_RIGHT, FALSE);
+            else
+            {
+                name0 = concat_dir_and_file (dir0, de->d_name);
+                if (dirdiff_compare_entries (path, name0, st0, name1, &st1, result, &interrupted))
+                {
+                    g_ptr_array_add (subdirs, path);
+                    path = NULL;
+                }
+                g_free (name0);
+                g_hash_table_remove (names, de->d_name);
+            }
+
+            g_free (path);
+            g_free (name1);
+            ok = !interrupted && !tty_got_interrupt ();
+        }
+        mc_closedir (d);
+    }
+
+    /* remaining entries of interrupted scan aren't known to be missing in the second tree */
+    if (ok)
+    {
+        scan.rel = rel;
+        scan.result = result;
+        g_hash_table_foreach (names, dirdiff_add_only_left, &scan);
+    }
+
+    g_hash_table_destroy (names);
+    g_free (dir1);
+    g_free (dir0);
+
+    /* directories are closed before descending, so number of open directories is constant */
+    for (i = 0; i < subdirs->len; i++)
+    {
+        ok = ok && dirdiff_scan (root0, root1, g_ptr_array_index (subdirs, i), result);
+        g_free (g_ptr_array_index (subdirs, i));
+    }
+    g_ptr_array_free (subdirs, TRUE);
+
+    return ok;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+dirdiff_show (const char *dir0, const char *dir1, GPtrArray * result)
+{
+    int pos = 0;
+    int cols = 40;
+    guint i;
+
+    for (i = 0; i < result->len; i++)
+    {
+        const dirdiff_entry_t *e = g_ptr_array_index (result, i);
+
+        cols = max (cols, str_term_width1 (e->path) + 4);
+    }
+    cols = min (cols, COLS - 6);
+
+    while (pos >= 0)
+    {
+        Listbox *listbox;
+        dirdiff_entry_t *e;
+
+        listbox = create_listbox_window (min ((int) result->len, LINES - 6), cols,
+                                         _("Compare directories"), "[Diff Viewer]");
+
+        for (i = 0; i < result->len; i++)
+        {
+            char *text;
+
+            e = (dirdiff_entry_t *) g_ptr_array_index (result, i);
+            text = g_strdup_printf ("%c  %s", dirdiff_marks[e->kind], e->path);
+            LISTBOX_APPEND_TEXT (listbox, 0, text, NULL);
+            g_free (text);
+        }
+        listbox_select_entry (listbox->list, pos);
+
+        pos = run_listbox (listbox);
+        if (pos < 0)
+            break;
+
+        e = (dirdiff_entry_t *) g_ptr_array_index (result, pos);
+        if (!e->is_file)
+            message (D_ERROR, MSG_ERROR, _("Only files present in both directories can be compared"));
+        else
+        {
+            char *file0, *file1;
+
+            file0 = concat_dir_and_file (dir0, e->path);
+            file1 = concat_dir_and_file (dir1, e->path);
+            dview_diff_files (file0, file1);
+            g_free (file1);
+            g_free (file0);
+        }
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/*** public functions ****************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Compare two directory trees recursively and show the list of differences.
+ * Selected pair of files is opened in the diff viewer.
+ *
+ * @param dir0 first directory
+ * @param dir1 second directory
+ *
+ * @return 0 on success, negative on error
+ */
+
+int
+dview_dir_diff (const char *dir0, const char *dir1)
+{
+    GPtrArray *result;
+    Dlg_head *d;
+    gboolean ok;
+
+    d = create_message (D_NORMAL, _("Compare directories"), "%s",
+                        _("Comparing directories...\nPress ESC to stop"));
+    tty_refresh ();
+
+    result = g_ptr_array_new ();
+
+    tty_enable_interrupt_key ();
+    ok = dirdiff_scan (dir0, dir1, "", result);
+    tty_disable_interrupt_key ();
+
+    dlg_run_done (d);
+    destroy_dlg (d);
+
+    g_ptr_array_sort (result, dirdiff_entry_cmp);
+
+    if (!ok)
+        message (D_NORMAL, _("Compare directories"), _("Comparison was interrupted"));
+
+    if (result->len == 0)
+    {
+        if (ok)
+            message (D_NORMAL, _("Compare directories"), _("Directories are identical"));
+    }
+    else
+        dirdiff_show (dir0, dir1, result);
+
+    g_ptr_array_foreach (result, dirdiff_entry_free, NULL);
+    g_ptr_array_free (result, TRUE);
+    return 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
@@ -0,0 +1,601 @@
+/*
+   Built-in line diff engine for the diff viewer
+
+   Copyright (C) 2011
+   The Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** \file
+ *  \brief Source: built-in line diff engine
+ *
+ *  Every line is mapped to an equivalence class: lines that are equal with
+ *  respect to the ignore options get the same class, so lines are compared as
+ *  integers.  Differences are found with Myers' O(ND) algorithm in linear
+ *  space (the way GNU diff does it).  The "fastest" quality first anchors the
+ *  lines which are unique in both files (patience diff) and runs Myers'
+ *  algorithm between anchors only.
+ */
+
+#include <config.h>
+
+#include <ctype.h>
+#include <limits.h>
+#include <string.h>
+
+#include "lib/global.h"
+
+#include "internal.h"
+
+/*** global variables ****************************************************************************/
+
+/*** file scope macro definitions ****************************************************************/
+
+#define DFF_TAB_WIDTH 8
+
+/*** file scope type declarations ****************************************************************/
+
+typedef struct
+{
+    const int *lines[2];        /* classes of lines */
+    int len[2];                 /* number of lines */
+    char *changed[2];           /* non-zero for lines which are not in common subsequence */
+    int *fdiag;                 /* furthest x of forward paths, indexed by diagonal */
+    int *bdiag;                 /* furthest x of backward paths, indexed by diagonal */
+    gboolean minimal;
+    int too_expensive;          /* cost of search when heuristic is used */
+} dff_engine_t;
+
+/*** file scope variables ************************************************************************/
+
+/*** file scope functions ************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+
+/**
+ * Get the representation of line used to compare it.
+ *
+ * \param dview diff viewer, source of options
+ * \param s line
+ * \param len length of line including newline
+ * \param out where to store the result
+ */
+static void
+dff_normalize (const WDiff * dview, const char *s, size_t len, GString * out)
+{
+    size_t i;
+    int col = 0;
+    gboolean eol;
+
+    g_string_truncate (out, 0);
+
+    eol = (len != 0 && s[len - 1] == '\n');
+    if (eol)
+    {
+        len--;
+        if (dview->opt.strip_trailing_cr && len != 0 && s[len - 1] == '\r')
+            len--;
+    }
+
+    for (i = 0; i < len; i++)
+    {
+        unsigned char c = (unsigned char) s[i];
+
+        if (isspace (c))
+        {
+            if (dview->opt.ignore_all_space)
+                continue;
+
+            if (dview->opt.ignore_space_change)
+            {
+                /* any sequence of white space is one space, trailing white space is ignored */
+                while (i + 1 < len && isspace ((unsigned char) s[i + 1]))
+                    i++;
+                if (i + 1 < len)
+                {
+                    g_string_append_c (out, ' ');
+                    col++;
+                }
+                continue;
+            }
+
+            if (c == '\t' && dview->opt.ignore_tab_expansion)
+            {
+                do
+                {
+                    g_string_append_c (out, ' ');
+                    col++;
+                }
+                while (col % DFF_TAB_WIDTH != 0);
+                continue;
+            }
+        }
+
+        if (dview->opt.ignore_case)
+            c = tolower (c);
+
+        g_string_append_c (out, (char) c);
+        col++;
+    }
+
+    /* incomplete last line differs from complete one unless white space is ignored */
+    if (eol && !dview->opt.ignore_space_change && !dview->opt.ignore_all_space)
+        g_string_append_c (out, '\n');
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/**
+ * Split text to lines and map every line to its class.
+ *
+ * \return array of classes, NULL if there are too many lines
+ */
+static int *
+dff_classify (const WDiff * dview, const char *text, size_t len, GHashTable * classes,
+              int *nlines)
+{
+    int *lines;
+    size_t i, n = 0;
+    GString *buf;
+
+    for (i = 0; i < len; i++)
+        if (text[i] == '\n')
+            n++;
+    if (len != 0 && text[len - 1] != '\n')
+        n++;
+
+    if (n >= INT_MAX / 4)
+        return NULL;
+
+    lines = g_new (int, n + 1);
+    buf = g_string_sized_new (128);
+
+    for (i = 0, n = 0; i < len; n++)
+    {
+        const char *nl;
+        size_t sz;
+        gpointer cls;
+
+        nl = memchr (text + i, '\n', len - i);
+        sz = (nl != NULL) ? (size_t) (nl - text) + 1 - i : len - i;
+
+        dff_normalize (dview, text + i, sz, buf);
+
+        cls = g_hash_table_lookup (classes, buf);
+        if (cls == NULL)
+        {
+            cls = GINT_TO_POINTER (g_hash_table_size (classes) + 1);
+            g_hash_table_insert (classes, g_string_new_len (buf->str, buf->len), cls);
+        }
+        lines[n] = GPOINTER_TO_INT (cls) - 1;
+
+        i += sz;
+    }
+
+    g_string_free (buf, TRUE);
+
+    *nlines = (int) n;
+    return lines;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+dff_string_free (gpointer data)
+{
+    g_string_free ((GString *) data, TRUE);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/**
+ * Find the midpoint of the shortest edit script for a box [xoff, xlim) x [yoff, ylim).
+ * If the search becomes too expensive and minimal diff is not required, the
+ * furthest reaching point found so far is used.
+ */
+static void
+dff_middle_snake (dff_engine_t * e, int xoff, int xlim, int yoff, int ylim, int *xmid, int *ymid)
+{
+    const int *xv = e->lines[0];
+    const int *yv = e->lines[1];
+    int *fd = e->fdiag;
+    int *bd = e->bdiag;
+    const int dmin = xoff - ylim;
+    const int dmax = xlim - yoff;
+    const int fmid = xoff - yoff;
+    const int bmid = xlim - ylim;
+    int fmin = fmid, fmax = fmid;
+    int bmin = bmid, bmax = bmid;
+    const gboolean odd = ((fmid - bmid) & 1) != 0;
+    int c;
+
+    fd[fmid] = xoff;
+    bd[bmid] = xlim;
+
+    for (c = 1;; c++)
+    {
+        int d;
+
+        /* extend the forward search by one edit */
+        if (fmin > dmin)
+            fd[--fmin - 1] = -1;
+        else
+            fmin++;
+        if (fmax < dmax)
+            fd[++fmax + 1] = -1;
+        else
+            fmax--;
+
+        for (d = fmax; d >= fmin; d -= 2)
+        {
+            int x, y;
+            int tlo = fd[d - 1];
+            int thi = fd[d + 1];
+
+            x = (tlo >= thi) ? tlo + 1 : thi;
+            y = x - d;
+            while (x < xlim && y < ylim && xv[x] == yv[y])
+            {
+                x++;
+                y++;
+            }
+            fd[d] = x;
+
+            if (odd && bmin <= d && d <= bmax && bd[d] <= x)
+            {
+                *xmid = x;
+                *ymid = y;
+                return;
+            }
+        }
+
+        /* extend the backward search by one edit */
+        if (bmin > dmin)
+            bd[--bmin - 1] = INT_MAX;
+        else
+            bmin++;
+        if (bmax < dmax)
+            bd[++bmax + 1] = INT_MAX;
+        else
+            bmax--;
+
+        for (d = bmax; d >= bmin; d -= 2)
+        {
+            int x, y;
+            int tlo = bd[d - 1];
+            int thi = bd[d + 1];
+
+            x = (tlo < thi) ? tlo : thi - 1;
+            y = x - d;
+            while (x > xoff && y > yoff && xv[x - 1] == yv[y - 1])
+            {
+                x--;
+                y--;
+            }
+            bd[d] = x;
+
+            if (!odd && fmin <= d && d <= fmax && x <= fd[d])
+            {
+                *xmid = x;
+                *ymid = y;
+                return;
+            }
+        }
+
+        if (!e->minimal && c >= e->too_expensive)
+        {
+            /* give up: take the point that got furthest from its corner */
+            int fxybest = -1, fxbest = xoff;
+            int bxybest = INT_MAX, bxbest = xlim;
+
+            for (d = fmax; d >= fmin; d -= 2)
+            {
+                int x, y;
+
+                x = MIN (fd[d], xlim);
+                y = x - d;
+                if (ylim < y)
+                {
+                    x = ylim + d;
+                    y = ylim;
+                }
+                if (fxybest < x + y)
+                {
+                    fxybest = x + y;
+                    fxbest = x;
+                }
+            }
+
+            for (d = bmax; d >= bmin; d -= 2)
+            {
+                int x, y;
+
+                x = MAX (xoff, bd[d]);
+                y = x - d;
+                if (y < yoff)
+                {
+                    x = yoff + d;
+                    y = yoff;
+                }
+                if (x + y < bxybest)
+                {
+                    bxybest = x + y;
+                    bxbest = x;
+                }
+            }
+
+            if ((xlim + ylim) - bxybest < fxybest - (xoff + yoff))
+            {
+                *xmid = fxbest;
+                *ymid = fxybest - fxbest;
+            }
+            else
+            {
+                *xmid = bxbest;
+                *ymid = bxybest - bxbest;
+            }
+            return;
+        }
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/**
+ * Mark lines of box [xoff, xlim) x [yoff, ylim) which are not in the common subsequence.
+ */
+static void
+dff_compare (dff_engine_t * e, int xoff, int xlim, int yoff, int ylim)
+{
+    const int *xv = e->lines[0];
+    const int *yv = e->lines[1];
+
+    /* skip common prefix and suffix */
+    while (xoff < xlim && yoff < ylim && xv[xoff] == yv[yoff])
+    {
+        xoff++;
+        yoff++;
+    }
+    while (xlim > xoff && ylim > yoff && xv[xlim - 1] == yv[ylim - 1])
+    {
+        xlim--;
+        ylim--;
+    }
+
+    if (xoff == xlim)
+        memset (e->changed[1] + yoff, 1, ylim - yoff);
+    else if (yoff == ylim)
+        memset (e->changed[0] + xoff, 1, xlim - xoff);
+    else
+    {
+        int xmid, ymid;
+
+        dff_middle_snake (e, xoff, xlim, yoff, ylim, &xmid, &ymid);
+        dff_compare (e, xoff, xmid, yoff, ymid);
+        dff_compare (e, xmid, xlim, ymid, ylim);
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/**
+ * Patience diff: match lines that occur exactly once in both files in the longest
+ * increasing sequence and compare the gaps between them.
+ */
+static void
+dff_compare_patience (dff_engine_t * e, int nclasses)
+{
+    int *count, *pos;
+    int *ax, *ay, *tail, *prev;
+    int i, n, k = 0, last;
+    int xoff = 0, yoff = 0;
+
+    /* count[2 * c] and count[2 * c + 1] are numbers of lines of class c in both files */
+    count = g_new0 (int, 2 * nclasses);
+    pos = g_new (int, nclasses);
+
+    for (i = 0; i < e->len[0]; i++)
+        count[2 * e->lines[0][i]]++;
+    for (i = 0; i < e->len[1]; i++)
+    {
+        count[2 * e->lines[1][i] + 1]++;
+        pos[e->lines[1][i]] = i;
+    }
+
+    /* anchor candidates in order of the first file */
+    ax = g_new (int, e->len[0] + 1);
+    ay = g_new (int, e->len[0] + 1);
+    for (i = 0, n = 0; i < e->len[0]; i++)
+    {
+        int c = e->lines[0][i];
+
+        if (count[2 * c] == 1 && count[2 * c + 1] == 1)
+        {
+            ax[n] = i;
+            ay[n] = pos[c];
+            n++;
+        }
+    }
+
+    g_free (count);
+    g_free (pos);
+
+    /* longest increasing subsequence of ay */
+    tail = g_new (int, n + 1);
+    prev = g_new (int, n + 1);
+    for (i = 0; i < n; i++)
+    {
+        int lo = 0, hi = k;
+
+        while (lo < hi)
+        {
+            int mid = lo + (hi - lo) / 2;
+
+            if (ay[tail[mid]] < ay[i])
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        prev[i] = (lo > 0) ? tail[lo - 1] : -1;
+        tail[lo] = i;
+        if (lo == k)
+            k++;
+    }
+
+    /* reverse the chain of anchors to tail[] */
+    for (i = k - 1, last = (k > 0) ? tail[k - 1] : -1; i >= 0; i--, last = prev[last])
+        tail[i] = last;
+
+    for (i = 0; i < k; i++)
+    {
+        dff_compare (e, xoff, ax[tail[i]], yoff, ay[tail[i]]);
+        xoff = ax[tail[i]] + 1;
+        yoff = ay[tail[i]] + 1;
+    }
+    dff_compare (e, xoff, e->len[0], yoff, e->len[1]);
+
+    g_free (tail);
+    g_free (prev);
+    g_free (ax);
+    g_free (ay);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/**
+ * Convert marks of changed lines to diff statements, like in "normal" diff output.
+ */
+static void
+dff_build_ops (const dff_engine_t * e, GArray * ops)
+{
+    int i = 0, j = 0;
+
+    while (i < e->len[0] || j < e->len[1])
+    {
+        DIFFCMD op;
+        int i0, j0;
+
+        if (i < e->len[0] && j < e->len[1] && !e->changed[0][i] && !e->changed[1][j])
+        {
+            i++;
+            j++;
+            continue;
+        }
+
+        i0 = i;
+        j0 = j;
+        while (i < e->len[0] && e->changed[0][i])
+            i++;
+        while (j < e->len[1] && e->changed[1][j])
+            j++;
+
+        if (i0 == i)
+        {
+            op.cmd = 'a';
+            op.a[0][0] = op.a[0][1] = i0;
+            op.a[1][0] = j0 + 1;
+            op.a[1][1] = j;
+        }
+        else if (j0 == j)
+        {
+            op.cmd = 'd';
+            op.a[0][0] = i0 + 1;
+            op.a[0][1] = i;
+            op.a[1][0] = op.a[1][1] = j0;
+        }
+        else
+        {
+            op.cmd = 'c';
+            op.a[0][0] = i0 + 1;
+            op.a[0][1] = i;
+            op.a[1][0] = j0 + 1;
+            op.a[1][1] = j;
+        }
+        g_array_append_val (ops, op);
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/*** public functions ****************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+
+/**
+ * Compare two texts in memory.
+ *
+ * \param dview diff viewer, source of options
+ * \param text contents of files
+ * \param len lengths of files
+ * \param ops list of diff statements to fill
+ *
+ * \return number of hunks, negative if texts can't be compared
+ */
+int
+dff_builtin (const WDiff * dview, char *const text[2], const size_t len[2], GArray * ops)
+{
+    dff_engine_t e;
+    GHashTable *classes;
+    int *lines[2];
+    int nclasses, diags, i;
+
+    classes = g_hash_table_new_full ((GHashFunc) g_string_hash, (GEqualFunc) g_string_equal,
+                                     dff_string_free, NULL);
+
+    lines[0] = dff_classify (dview, text[0], len[0], classes, &e.len[0]);
+    lines[1] = dff_classify (dview, text[1], len[1], classes, &e.len[1]);
+    nclasses = (int) g_hash_table_size (classes);
+    g_hash_table_destroy (classes);
+
+    if (lines[0] == NULL || lines[1] == NULL)
+    {
+        g_free (lines[0]);
+        g_free (lines[1]);
+        return -1;
+    }
+
+    e.lines[0] = lines[0];
+    e.lines[1] = lines[1];
+    e.changed[0] = g_new0 (char, e.len[0] + 1);
+    e.changed[1] = g_new0 (char, e.len[1] + 1);
+
+    /* diagonals are in [-len[1] - 1, len[0] + 1] */
+    diags = e.len[0] + e.len[1] + 3;
+    e.fdiag = g_new (int, diags) + e.len[1] + 1;
+    e.bdiag = g_new (int, diags) + e.len[1] + 1;
+
+    e.minimal = (dview->opt.quality == 2);
+    /* like GNU diff: about square root of the number of diagonals, but not less than 4096 */
+    for (e.too_expensive = 1, i = diags; i != 0; i >>= 2)
+        e.too_expensive <<= 1;
+    e.too_expensive = MAX (4096, e.too_expensive);
+
+    if (dview->opt.quality == 1)
+        dff_compare_patience (&e, nclasses);
+    else
+        dff_compare (&e, 0, e.len[0], 0, e.len[1]);
+
+    dff_build_ops (&e, ops);
+
+    g_free (e.fdiag - e.len[1] - 1);
+    g_free (e.bdiag - e.len[1] - 1);
+    g_free (e.changed[0]);
+    g_free (e.changed[1]);
+    g_free (lines[0]);
+    g_free (lines[1]);
+
+    return ops->len;
+}
+
+/* --------------------------------------------------------------------------------------------- */
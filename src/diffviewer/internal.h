@@ -9,9 +9,6 @@
 
 /*** typedefs(not structures) and defined constants **********************************************/
 
-typedef int (*DFUNC) (void *ctx, int ch, int line, off_t off, size_t sz, const char *str);
-typedef int PAIR[2];
-
 #define error_dialog(h, s) query_dialog(h, s, D_ERROR, 1, _("&Dismiss"))
 
 /*** enums ***************************************************************************************/
@@ -19,8 +16,7 @@ typedef int PAIR[2];
 typedef enum
 {
     DATA_SRC_MEM = 0,
-    DATA_SRC_TMP = 1,
-    DATA_SRC_ORG = 2
+    DATA_SRC_ORG = 1
 } DSRC;
 
 typedef enum
@@ -58,22 +54,22 @@ typedef struct
 
 typedef struct
 {
-    int ch;
-    int line;
-    union
-    {
-        off_t off;
-        size_t len;
-    } u;
-    void *p;
-} DIFFLN;
+    size_t row;                 /* first row of hunk */
+    int line[2];                /* first line of hunk, or line after it if hunk has no lines */
+    int len[2];                 /* number of lines of hunk */
+    int cmd;
+} DIFFHUNK;
 
 typedef struct
 {
-    FBUF *f;
-    GArray *a;
-    DSRC dsrc;
-} PRINTER_CTX;
+    int ch;
+    int line;                   /* 0 for padding rows */
+    off_t off;                  /* offset of line inside file */
+    size_t len;                 /* length of line without newline */
+    const char *p;              /* text of line, owned by the line cache */
+} DIFFLN;
+
+typedef struct dview_lines_struct DIFFLINES;
 
 typedef struct WDiff
 {
@@ -85,10 +81,12 @@ typedef struct WDiff
     FBUF *f[2];
     const char *backup_sufix;
     gboolean merged;
-    GArray *a[2];
-    GPtrArray *hdiff;
+    GArray *hunks;              /* list of DIFFHUNK */
+    size_t nrows;               /* number of rows */
+    DIFFLINES *lines;           /* line indexes and cache of read lines */
+    GHashTable *hdiff;
     int ndiff;                  /* number of hunks */
-    DSRC dsrc;                  /* data source: memory or temporary file */
+    DSRC dsrc;                  /* data source: cached lines or original file */
 
     int view_quit:1;            /* Quit flag */
 
@@ -136,11 +134,19 @@ typedef struct WDiff
 
 /*** declarations of public functions ************************************************************/
 
+/* dirdiff.c */
+int dview_dir_diff (const char *dir0, const char *dir1);
+
+/* engine.c */
+int dff_builtin (const WDiff * dview, char *const text[2], const size_t len[2], GArray * ops);
+
 /* search.c */
 void dview_search_cmd (WDiff * dview);
 void dview_continue_search_cmd (WDiff * dview);
 
 /* ydiff.c */
 void dview_update (WDiff * dview);
+int dview_diff_files (char *file0, char *file1);
+gboolean dview_get_row (const WDiff * dview, int ord, size_t row, DIFFLN * p);
 
 #endif /* MC__DIFFVIEW_INTERNAL_H */
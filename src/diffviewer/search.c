@@ -174,7 +174,7 @@ static gboolean
 mcdiffview_do_search_backward (WDiff * dview)
 {
     ssize_t ind;
-    DIFFLN *p;
+    DIFFLN p;
 
     if (dview->search.last_accessed_num_line < 0)
     {
@@ -182,16 +182,16 @@ mcdiffview_do_search_backward (WDiff * dview)
         return FALSE;
     }
 
-    if ((size_t) dview->search.last_accessed_num_line >= dview->a[dview->ord]->len)
-        dview->search.last_accessed_num_line = (ssize_t) dview->a[dview->ord]->len;
+    if ((size_t) dview->search.last_accessed_num_line >= dview->nrows)
+        dview->search.last_accessed_num_line = (ssize_t) dview->nrows;
 
     for (ind = --dview->search.last_accessed_num_line; ind >= 0; ind--)
     {
-        p = (DIFFLN *) & g_array_index (dview->a[dview->ord], DIFFLN, (size_t) ind);
-        if (p->u.len == 0)
+        dview_get_row (dview, dview->ord, (size_t) ind, &p);
+        if (p.len == 0)
             continue;
 
-        if (mc_search_run (dview->search.handle, p->p, 0, p->u.len, NULL))
+        if (mc_search_run (dview->search.handle, p.p, 0, p.len, NULL))
         {
             dview->skip_rows = dview->search.last_found_line =
                 dview->search.last_accessed_num_line = ind;
@@ -208,24 +208,24 @@ static gboolean
 mcdiffview_do_search_forward (WDiff * dview)
 {
     size_t ind;
-    DIFFLN *p;
+    DIFFLN p;
 
     if (dview->search.last_accessed_num_line < 0)
         dview->search.last_accessed_num_line = -1;
-    else if ((size_t) dview->search.last_accessed_num_line >= dview->a[dview->ord]->len)
+    else if ((size_t) dview->search.last_accessed_num_line >= dview->nrows)
     {
-        dview->search.last_accessed_num_line = (ssize_t) dview->a[dview->ord]->len;
+        dview->search.last_accessed_num_line = (ssize_t) dview->nrows;
         return FALSE;
     }
 
-    for (ind = (size_t)++ dview->search.last_accessed_num_line; ind < dview->a[dview->ord]->len;
+    for (ind = (size_t)++ dview->search.last_accessed_num_line; ind < dview->nrows;
          ind++)
     {
-        p = (DIFFLN *) & g_array_index (dview->a[dview->ord], DIFFLN, ind);
-        if (p->u.len == 0)
+        dview_get_row (dview, dview->ord, ind, &p);
+        if (p.len == 0)
             continue;
 
-        if (mc_search_run (dview->search.handle, p->p, 0, p->u.len, NULL))
+        if (mc_search_run (dview->search.handle, p.p, 0, p.len, NULL))
         {
             dview->skip_rows = dview->search.last_found_line =
                 dview->search.last_accessed_num_line = (ssize_t) ind;
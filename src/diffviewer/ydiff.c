@@ -60,19 +60,14 @@
 
 /*** file scope macro definitions ****************************************************************/
 
-#define g_array_foreach(a, TP, cbf) \
-do { \
-    size_t g_array_foreach_i;\
-    TP *g_array_foreach_var=NULL; \
-    for (g_array_foreach_i=0;g_array_foreach_i < a->len; g_array_foreach_i++) \
-    { \
-        g_array_foreach_var = &g_array_index(a,TP,g_array_foreach_i); \
-        (*cbf) (g_array_foreach_var); \
-    } \
-} while (0)
-
 #define FILE_READ_BUF 4096
-#define FILE_FLAG_TEMP (1 << 0)
+
+/* offset of every DIFF_INDEX_STEP-th line is kept */
+#define DIFF_INDEX_STEP 256
+/* number of lines kept in memory */
+#define DIFF_CACHE_SIZE 256
+/* larger files are compared by external diff instead of reading them into memory */
+#define DIFF_BUILTIN_MAX_SIZE (64 * 1024 * 1024)
 
 #define OPTX 56
 #define OPTY 17
@@ -84,7 +79,7 @@ do { \
 
 #define HDIFF_ENABLE 1
 #define HDIFF_MINCTX 5
-#define HDIFF_DEPTH 10
+#define HDIFF_MAXCOST 256
 
 #define FILE_DIRTY(fs) \
 do \
@@ -96,6 +91,35 @@ while (0)
 
 /*** file scope type declarations ****************************************************************/
 
+typedef struct
+{
+    GArray *off;                /* offsets of lines 1, DIFF_INDEX_STEP + 1, ... */
+    int lines;                  /* number of lines */
+    /* the last read block of DIFF_INDEX_STEP lines */
+    int block_first;            /* first line of block, 0 if there is no block */
+    int block_lines;            /* number of lines in block */
+    off_t block_off;            /* offset of block inside file */
+    GString *block;             /* text of block */
+    size_t block_start[DIFF_INDEX_STEP + 1];    /* offsets of lines inside block */
+} DIFFINDEX;
+
+typedef struct
+{
+    int ord;
+    int line;                   /* 0 if entry is free */
+    off_t off;
+    size_t len;
+    char *p;
+    unsigned long stamp;        /* time of last use */
+} DIFFCACHE;
+
+struct dview_lines_struct
+{
+    DIFFINDEX index[2];
+    DIFFCACHE cache[DIFF_CACHE_SIZE];
+    unsigned long stamp;
+};
+
 /*** file scope variables ************************************************************************/
 
 /*** file scope functions ************************************************************************/
@@ -180,35 +204,6 @@ rewrite_backup_content (const char *from_file_name, const char *to_file_name)
 
 /* buffered I/O ************************************************************* */
 
-/**
- * Try to open a temporary file.
- *
- * \param[out] name address of a pointer to store the temporary name
- *
- * \return file descriptor on success, negative on error
- *
- * \note the name is not altered if this function fails
- */
-
-static int
-open_temp (void **name)
-{
-    int fd;
-    char *diff_file_name = NULL;
-
-    fd = mc_mkstemps (&diff_file_name, "mcdiff", NULL);
-    if (fd == -1)
-    {
-        message (D_ERROR, MSG_ERROR,
-                 _("Cannot create temporary diff file\n%s"), unix_error_string (errno));
-        return -1;
-    }
-    *name = diff_file_name;
-    return fd;
-}
-
-/* --------------------------------------------------------------------------------------------- */
-
 /**
  * Alocate file structure and associate file descriptor to it.
  *
@@ -255,51 +250,12 @@ f_dopen (int fd)
 static int
 f_free (FBUF * fs)
 {
-    int rv = 0;
-    if (fs->flags & FILE_FLAG_TEMP)
-    {
-        rv = unlink (fs->data);
-        g_free (fs->data);
-    }
     g_free (fs->buf);
     g_free (fs);
-    return rv;
+    return 0;
 }
 
 
-/* --------------------------------------------------------------------------------------------- */
-
-/**
- * Open a binary temporary file in R/W mode.
- *
- * \return file structure
- *
- * \note the file will be deleted when closed
- */
-static FBUF *
-f_temp (void)
-{
-    int fd;
-    FBUF *fs;
-
-    fs = f_dopen (0);
-    if (fs == NULL)
-    {
-        return NULL;
-    }
-
-    fd = open_temp (&fs->data);
-    if (fd < 0)
-    {
-        f_free (fs);
-        return NULL;
-    }
-
-    fs->fd = fd;
-    fs->flags = FILE_FLAG_TEMP;
-    return fs;
-}
-
 /* --------------------------------------------------------------------------------------------- */
 
 /**
@@ -446,68 +402,12 @@ f_reset (FBUF * fs)
 
 /* --------------------------------------------------------------------------------------------- */
 
-/**
- * Write bytes to file.
- *
- * \param fs file structure
- * \param buf source buffer
- * \param size size of buffer
- *
- * \return number of written bytes, -1 on error
- *
- * \note thrashes read cache
- */
-static ssize_t
-f_write (FBUF * fs, const char *buf, size_t size)
-{
-    ssize_t rv = write (fs->fd, buf, size);
-    if (rv >= 0)
-    {
-        FILE_DIRTY (fs);
-    }
-    return rv;
-}
-
-/* --------------------------------------------------------------------------------------------- */
-
-/**
- * Truncate file to the current position.
- *
- * \param fs file structure
- *
- * \return current file size on success, negative on error
- *
- * \note thrashes read cache
- */
-static off_t
-f_trunc (FBUF * fs)
-{
-    off_t off = lseek (fs->fd, 0, SEEK_CUR);
-    if (off != -1)
-    {
-        int rv = ftruncate (fs->fd, off);
-        if (rv != 0)
-        {
-            off = -1;
-        }
-        else
-        {
-            FILE_DIRTY (fs);
-        }
-    }
-    return off;
-}
-
-/* --------------------------------------------------------------------------------------------- */
-
 /**
  * Close file.
  *
  * \param fs file structure
  *
  * \return 0 on success, non-zero on error
- *
- * \note if this is temporary file, it is deleted
  */
 static int
 f_close (FBUF * fs)
@@ -894,353 +794,459 @@ dff_execute (const char *args, const char *extra, const char *file1, const char
 }
 
 /* --------------------------------------------------------------------------------------------- */
+/* rows and lines *********************************************************** */
 
 /**
- * Reparse and display file according to diff statements.
+ * Add line to the line index.
  *
- * \param ord 0 if displaying first file, 1 if displaying 2nd file
- * \param filename file name to display
- * \param ops list of diff statements
- * \param printer printf-like function to be used for displaying
- * \param ctx printer context
- *
- * \return 0 if success, otherwise non-zero
+ * \param idx line index
+ * \param off offset of line inside file
  */
-static int
-dff_reparse (int ord, const char *filename, const GArray * ops, DFUNC printer, void *ctx)
+static void
+dview_index_add (DIFFINDEX * idx, off_t off)
 {
-    size_t i;
-    FBUF *f;
-    size_t sz;
-    char buf[BUFSIZ];
-    int line = 0;
-    off_t off = 0;
-    const DIFFCMD *op;
-    int eff;
-    int add_cmd;
-    int del_cmd;
-
-    f = f_open (filename, O_RDONLY);
-    if (f == NULL)
-    {
-        return -1;
-    }
+    if (idx->lines % DIFF_INDEX_STEP == 0)
+        g_array_append_val (idx->off, off);
+    idx->lines++;
+}
 
-    ord &= 1;
-    eff = ord;
+/* --------------------------------------------------------------------------------------------- */
 
-    add_cmd = 'a';
-    del_cmd = 'd';
-    if (ord)
-    {
-        add_cmd = 'd';
-        del_cmd = 'a';
-    }
-#define F1 a[eff][0]
-#define F2 a[eff][1]
-#define T1 a[ ord^1 ][0]
-#define T2 a[ ord^1 ][1]
-    for (i = 0; i < ops->len; i++)
+/**
+ * Build line index of file.
+ *
+ * \param idx line index to fill
+ * \param f file to index
+ * \param text contents of file if it has been already read, NULL otherwise
+ * \param len length of text
+ *
+ * \return TRUE if success, FALSE otherwise
+ */
+static gboolean
+dview_index_file (DIFFINDEX * idx, FBUF * f, const char *text, size_t len)
+{
+    g_array_set_size (idx->off, 0);
+    idx->lines = 0;
+    idx->block_first = 0;
+
+    if (text != NULL)
     {
-        int n;
-        op = &g_array_index (ops, DIFFCMD, i);
-        n = op->F1 - (op->cmd != add_cmd);
-        while (line < n && (sz = f_gets (buf, sizeof (buf), f)) != 0)
-        {
-            line++;
-            printer (ctx, EQU_CH, line, off, sz, buf);
-            off += sz;
-            while (buf[sz - 1] != '\n')
-            {
-                sz = f_gets (buf, sizeof (buf), f);
-                if (sz == 0)
-                {
-                    printer (ctx, 0, 0, 0, 1, "\n");
-                    break;
-                }
-                printer (ctx, 0, 0, 0, sz, buf);
-                off += sz;
-            }
-        }
-        if (line != n)
-        {
-            goto err;
-        }
+        const char *p = text;
+        const char *end = text + len;
 
-        if (op->cmd == add_cmd)
+        while (p < end)
         {
-            n = op->T2 - op->T1 + 1;
-            while (n)
-            {
-                printer (ctx, DEL_CH, 0, 0, 1, "\n");
-                n--;
-            }
-        }
-        if (op->cmd == del_cmd)
-        {
-            n = op->F2 - op->F1 + 1;
-            while (n != 0 && (sz = f_gets (buf, sizeof (buf), f)) != 0)
-            {
-                line++;
-                printer (ctx, ADD_CH, line, off, sz, buf);
-                off += sz;
-                while (buf[sz - 1] != '\n')
-                {
-                    sz = f_gets (buf, sizeof (buf), f);
-                    if (sz == 0)
-                    {
-                        printer (ctx, 0, 0, 0, 1, "\n");
-                        break;
-                    }
-                    printer (ctx, 0, 0, 0, sz, buf);
-                    off += sz;
-                }
-                n--;
-            }
-            if (n)
-            {
-                goto err;
-            }
-        }
-        if (op->cmd == 'c')
-        {
-            n = op->F2 - op->F1 + 1;
-            while (n != 0 && (sz = f_gets (buf, sizeof (buf), f)) != 0)
-            {
-                line++;
-                printer (ctx, CHG_CH, line, off, sz, buf);
-                off += sz;
-                while (buf[sz - 1] != '\n')
-                {
-                    sz = f_gets (buf, sizeof (buf), f);
-                    if (sz == 0)
-                    {
-                        printer (ctx, 0, 0, 0, 1, "\n");
-                        break;
-                    }
-                    printer (ctx, 0, 0, 0, sz, buf);
-                    off += sz;
-                }
-                n--;
-            }
-            if (n)
-            {
-                goto err;
-            }
-            n = op->T2 - op->T1 - (op->F2 - op->F1);
-            while (n > 0)
-            {
-                printer (ctx, CHG_CH, 0, 0, 1, "\n");
-                n--;
-            }
+            const char *nl;
+
+            dview_index_add (idx, p - text);
+            nl = memchr (p, '\n', end - p);
+            if (nl == NULL)
+                break;
+            p = nl + 1;
         }
     }
-#undef T2
-#undef T1
-#undef F2
-#undef F1
-
-    while ((sz = f_gets (buf, sizeof (buf), f)) != 0)
+    else
     {
-        line++;
-        printer (ctx, EQU_CH, line, off, sz, buf);
-        off += sz;
-        while (buf[sz - 1] != '\n')
+        char buf[BUFSIZ];
+        size_t sz;
+        off_t off = 0;
+        gboolean bol = TRUE;
+
+        if (f_reset (f) == -1)
+            return FALSE;
+
+        while ((sz = f_gets (buf, sizeof (buf), f)) != 0)
         {
-            sz = f_gets (buf, sizeof (buf), f);
-            if (sz == 0)
-            {
-                printer (ctx, 0, 0, 0, 1, "\n");
-                break;
-            }
-            printer (ctx, 0, 0, 0, sz, buf);
+            if (bol)
+                dview_index_add (idx, off);
             off += sz;
+            bol = buf[sz - 1] == '\n';
         }
     }
 
-    f_close (f);
-    return 0;
+    return TRUE;
+}
 
-  err:
-    f_close (f);
-    return -1;
+/* --------------------------------------------------------------------------------------------- */
+
+/**
+ * Forget all read lines.
+ *
+ * \param lines line cache
+ */
+static void
+dview_flush_lines (DIFFLINES * lines)
+{
+    size_t i;
+
+    for (i = 0; i < DIFF_CACHE_SIZE; i++)
+    {
+        g_free (lines->cache[i].p);
+        lines->cache[i].p = NULL;
+        lines->cache[i].line = 0;
+        lines->cache[i].stamp = 0;
+    }
+    lines->stamp = 0;
+
+    for (i = 0; i < 2; i++)
+    {
+        if (lines->index[i].block != NULL)
+            g_string_free (lines->index[i].block, TRUE);
+        lines->index[i].block = NULL;
+        lines->index[i].block_first = 0;
+    }
 }
 
 /* --------------------------------------------------------------------------------------------- */
-/* horizontal diff ********************************************************** */
 
 /**
- * Longest common substring.
+ * Read block of DIFF_INDEX_STEP lines which contains given line, if it isn't read yet.
+ * Lines before and after the required one are kept, so scrolling and search
+ * in both directions read the file once per block.
  *
- * \param s first string
- * \param m length of first string
- * \param t second string
- * \param n length of second string
- * \param ret list of offsets for longest common substrings inside each string
- * \param min minimum length of common substrings
+ * \param dview WDiff widget
+ * \param ord 0 if reading from first file, 1 if reading from 2nd file
+ * \param line number of line
  *
- * \return 0 if success, nonzero otherwise
+ * \return TRUE if success, FALSE otherwise
  */
-static int
-lcsubstr (const char *s, int m, const char *t, int n, GArray * ret, int min)
+static gboolean
+dview_load_block (const WDiff * dview, int ord, int line)
 {
-    int i, j;
+    DIFFINDEX *idx = &dview->lines->index[ord];
+    int first;
+    off_t off;
+    char buf[BUFSIZ];
+    size_t sz;
+    int n = 0;
 
-    int *Lprev, *Lcurr;
+    first = (line - 1) / DIFF_INDEX_STEP * DIFF_INDEX_STEP + 1;
+    if (idx->block_first == first)
+        return TRUE;
 
-    int z = 0;
+    idx->block_first = 0;
+    if (idx->block == NULL)
+        idx->block = g_string_sized_new (BUFSIZ);
+    else
+        g_string_truncate (idx->block, 0);
+
+    off = g_array_index (idx->off, off_t, (line - 1) / DIFF_INDEX_STEP);
+    if (f_seek (dview->f[ord], off, SEEK_SET) == -1)
+        return FALSE;
 
-    if (m < min || n < min)
+    idx->block_start[0] = 0;
+    while (n < DIFF_INDEX_STEP && (sz = f_gets (buf, sizeof (buf), dview->f[ord])) != 0)
     {
-        /* XXX early culling */
-        return 0;
+        g_string_append_len (idx->block, buf, sz);
+        if (buf[sz - 1] == '\n')
+            idx->block_start[++n] = idx->block->len;
     }
 
-    Lprev = g_new0 (int, n + 1);
-    Lcurr = g_new0 (int, n + 1);
+    /* the last line without newline */
+    if (n < DIFF_INDEX_STEP && idx->block->len > idx->block_start[n])
+        idx->block_start[++n] = idx->block->len;
+
+    idx->block_first = first;
+    idx->block_lines = n;
+    idx->block_off = off;
+
+    return TRUE;
+}
 
-    if (Lprev == NULL || Lcurr == NULL)
+/* --------------------------------------------------------------------------------------------- */
+
+/**
+ * Get line of file.  Line is taken from the block of lines around it
+ * if it is not in the cache.
+ *
+ * \param dview WDiff widget
+ * \param ord 0 if reading from first file, 1 if reading from 2nd file
+ * \param line number of line
+ *
+ * \return cache entry, NULL on error
+ */
+static const DIFFCACHE *
+dview_get_line (const WDiff * dview, int ord, int line)
+{
+    DIFFLINES *lines = dview->lines;
+    DIFFINDEX *idx = &lines->index[ord];
+    DIFFCACHE *e = NULL;
+    size_t i, start, len;
+
+    for (i = 0; i < DIFF_CACHE_SIZE; i++)
     {
-        g_free (Lprev);
-        g_free (Lcurr);
-        return -1;
+        DIFFCACHE *c = &lines->cache[i];
+
+        if (c->line == line && c->ord == ord)
+        {
+            c->stamp = ++lines->stamp;
+            return c;
+        }
+
+        /* free or least recently used entry is replaced */
+        if (e == NULL || c->stamp < e->stamp)
+            e = c;
     }
 
-    for (i = 0; i < m; i++)
+    if (line < 1 || line > idx->lines)
+        return NULL;
+
+    if (!dview_load_block (dview, ord, line))
+        return NULL;
+
+    /* file has been changed */
+    if (line - idx->block_first >= idx->block_lines)
+        return NULL;
+
+    start = idx->block_start[line - idx->block_first];
+    len = idx->block_start[line - idx->block_first + 1] - start;
+    if (len != 0 && idx->block->str[start + len - 1] == '\n')
+        len--;
+
+    g_free (e->p);
+    e->ord = ord;
+    e->line = line;
+    e->off = idx->block_off + (off_t) start;
+    e->len = len;
+    e->p = g_strndup (idx->block->str + start, len);
+    e->stamp = ++lines->stamp;
+
+    return e;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/**
+ * Build list of hunks.
+ *
+ * \param dview WDiff widget
+ * \param ops list of diff statements
+ *
+ * \return TRUE if success, FALSE if diff statements don't match the files
+ */
+static gboolean
+dview_build_hunks (WDiff * dview, const GArray * ops)
+{
+    const DIFFINDEX *idx = dview->lines->index;
+    int next[2] = { 1, 1 };     /* first line after the previous hunk */
+    size_t i, row = 0;
+    int ord;
+
+    g_array_set_size (dview->hunks, 0);
+    dview->nrows = 0;
+
+    for (i = 0; i < ops->len; i++)
     {
-        int *L = Lprev;
-        Lprev = Lcurr;
-        Lcurr = L;
-#ifdef USE_MEMSET_IN_LCS
-        memset (Lcurr, 0, (n + 1) * sizeof (int));
-#endif
-        for (j = 0; j < n; j++)
+        const DIFFCMD *op = &g_array_index (ops, DIFFCMD, i);
+        DIFFHUNK h;
+
+        for (ord = 0; ord < 2; ord++)
         {
-#ifndef USE_MEMSET_IN_LCS
-            Lcurr[j + 1] = 0;
-#endif
-            if (s[i] == t[j])
+            if (op->cmd == (ord == 0 ? 'a' : 'd'))
             {
-                int v = Lprev[j] + 1;
-                Lcurr[j + 1] = v;
-                if (z < v)
-                {
-                    z = v;
-                    g_array_set_size (ret, 0);
-                }
-                if (z == v && z >= min)
-                {
-                    int off0 = i - z + 1;
-                    int off1 = j - z + 1;
-                    size_t k;
-                    for (k = 0; k < ret->len; k++)
-                    {
-                        PAIR *p = (PAIR *) g_array_index (ret, PAIR, k);
-                        if ((*p)[0] == off0)
-                        {
-                            break;
-                        }
-                        if ((*p)[1] >= off1)
-                        {
-                            break;
-                        }
-                    }
-                    if (k == ret->len)
-                    {
-                        PAIR p2;
-                        p2[0] = off0;
-                        p2[1] = off1;
-                        g_array_append_val (ret, p2);
-                    }
-                }
+                /* lines of other file are added after line a[ord][0] */
+                h.line[ord] = op->a[ord][0] + 1;
+                h.len[ord] = 0;
+            }
+            else
+            {
+                h.line[ord] = op->a[ord][0];
+                h.len[ord] = op->a[ord][1] - op->a[ord][0] + 1;
             }
         }
+
+        if (h.line[0] < next[0] || h.line[0] - next[0] != h.line[1] - next[1])
+            return FALSE;
+
+        row += h.line[0] - next[0];
+        h.row = row;
+        h.cmd = op->cmd;
+        row += max (h.len[0], h.len[1]);
+        next[0] = h.line[0] + h.len[0];
+        next[1] = h.line[1] + h.len[1];
+        g_array_append_val (dview->hunks, h);
+    }
+
+    if (idx[0].lines + 1 < next[0] || idx[0].lines - next[0] != idx[1].lines - next[1])
+        return FALSE;
+
+    dview->nrows = row + idx[0].lines + 1 - next[0];
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/**
+ * Find the last hunk which starts at or before the row.
+ *
+ * \param dview WDiff widget
+ * \param row row number
+ *
+ * \return hunk, NULL if there is no such hunk
+ */
+static const DIFFHUNK *
+dview_find_hunk (const WDiff * dview, size_t row)
+{
+    size_t lo = 0, hi = dview->hunks->len;
+
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (g_array_index (dview->hunks, DIFFHUNK, mid).row <= row)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo == 0 ? NULL : &g_array_index (dview->hunks, DIFFHUNK, lo - 1);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static inline size_t
+dview_hunk_rows (const DIFFHUNK * h)
+{
+    return (size_t) max (h->len[0], h->len[1]);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/**
+ * Find row where line of file is shown.
+ *
+ * \param dview WDiff widget
+ * \param ord 0 for first file, 1 for 2nd file
+ * \param line line number
+ *
+ * \return row number, number of rows if there is no such line
+ */
+static size_t
+dview_line_to_row (const WDiff * dview, int ord, int line)
+{
+    const DIFFHUNK *h;
+    size_t lo = 0, hi = dview->hunks->len;
+
+    if (line < 1 || line > dview->lines->index[ord].lines)
+        return dview->nrows;
+
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (g_array_index (dview->hunks, DIFFHUNK, mid).line[ord] <= line)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
 
-    free (Lcurr);
-    free (Lprev);
-    return z;
+    if (lo == 0)
+        return line - 1;
 
-    free (Lcurr);
-    free (Lprev);
-    return -1;
+    h = &g_array_index (dview->hunks, DIFFHUNK, lo - 1);
+    if (line < h->line[ord] + h->len[ord])
+        return h->row + line - h->line[ord];
+    return h->row + dview_hunk_rows (h) + line - h->line[ord] - h->len[ord];
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/**
+ * Get kind and line number of row.
+ *
+ * \param dview WDiff widget
+ * \param ord 0 for first file, 1 for 2nd file
+ * \param row row number
+ * \param p row to fill, text of line is not read
+ */
+static void
+dview_get_row_info (const WDiff * dview, int ord, size_t row, DIFFLN * p)
+{
+    const DIFFHUNK *h;
+
+    p->ch = EQU_CH;
+    p->line = row + 1;
+    p->off = 0;
+    p->len = 0;
+    p->p = NULL;
+
+    h = dview_find_hunk (dview, row);
+    if (h != NULL)
+    {
+        size_t k = row - h->row;
+
+        if (k < dview_hunk_rows (h))
+        {
+            if (h->cmd == 'c')
+                p->ch = CHG_CH;
+            else
+                p->ch = h->len[ord] != 0 ? ADD_CH : DEL_CH;
+            p->line = k < (size_t) h->len[ord] ? h->line[ord] + (int) k : 0;
+        }
+        else
+            p->line = h->line[ord] + h->len[ord] + (int) (k - dview_hunk_rows (h));
+    }
 }
 
 /* --------------------------------------------------------------------------------------------- */
+/* horizontal diff ********************************************************** */
 
 /**
- * Scan recursively for common substrings and build ranges.
+ * Find the shortest edit script for two strings by the greedy Myers algorithm.
+ *
+ * Furthest reaching points of every diagonal are stored for each edit cost,
+ * so the script can be traced back.  Search is abandoned when the cost
+ * exceeds HDIFF_MAXCOST, so the time is O((m + n) * HDIFF_MAXCOST) at worst.
  *
  * \param s first string
+ * \param m length of first string
  * \param t second string
- * \param bracket current limits for both of the strings
- * \param min minimum length of common substrings
- * \param hdiff list of horizontal diff ranges to fill
- * \param depth recursion depth
+ * \param n length of second string
+ * \param trace array of furthest reaching points to fill: (2 * d + 1) values for each cost d
  *
- * \return 0 if success, nonzero otherwise
+ * \return cost of edit script, negative if it is greater than HDIFF_MAXCOST
  */
-static gboolean
-hdiff_multi (const char *s, const char *t, const BRACKET bracket, int min, GArray * hdiff,
-             unsigned int depth)
+static int
+hdiff_myers (const char *s, int m, const char *t, int n, GArray * trace)
 {
-    BRACKET p;
+    int *v;
+    int dmax, d;
 
-    if (depth--)
+    dmax = min (m + n, HDIFF_MAXCOST);
+    /* v[dmax + 1 + k] is furthest reaching x on diagonal k */
+    v = g_new0 (int, 2 * dmax + 3);
+
+    for (d = 0; d <= dmax; d++)
     {
-        GArray *ret;
-        BRACKET b;
-        int len;
-        ret = g_array_new (FALSE, TRUE, sizeof (PAIR));
-        if (ret == NULL)
-            return FALSE;
+        int k;
 
-        len = lcsubstr (s + bracket[0].off, bracket[0].len,
-                        t + bracket[1].off, bracket[1].len, ret, min);
-        if (ret->len != 0)
+        for (k = -d; k <= d; k += 2)
         {
-            size_t k = 0;
-            const PAIR *data = (const PAIR *) &g_array_index (ret, PAIR, 0);
-            const PAIR *data2;
-
-            b[0].off = bracket[0].off;
-            b[0].len = (*data)[0];
-            b[1].off = bracket[1].off;
-            b[1].len = (*data)[1];
-            if (!hdiff_multi (s, t, b, min, hdiff, depth))
-                return FALSE;
-
-            for (k = 0; k < ret->len - 1; k++)
+            int *vk = v + dmax + 1 + k;
+            int x, y;
+
+            if (k == -d || (k != d && vk[-1] < vk[1]))
+                x = vk[1];
+            else
+                x = vk[-1] + 1;
+
+            for (y = x - k; x < m && y < n && s[x] == t[y]; x++, y++)
+                ;
+            *vk = x;
+
+            if (x >= m && y >= n)
             {
-                data = (const PAIR *) &g_array_index (ret, PAIR, k);
-                data2 = (const PAIR *) &g_array_index (ret, PAIR, k + 1);
-                b[0].off = bracket[0].off + (*data)[0] + len;
-                b[0].len = (*data2)[0] - (*data)[0] - len;
-                b[1].off = bracket[1].off + (*data)[1] + len;
-                b[1].len = (*data2)[1] - (*data)[1] - len;
-                if (!hdiff_multi (s, t, b, min, hdiff, depth))
-                    return FALSE;
+                g_array_append_vals (trace, v + dmax + 1 - d, 2 * d + 1);
+                g_free (v);
+                return d;
             }
-            data = (const PAIR *) &g_array_index (ret, PAIR, k);
-            b[0].off = bracket[0].off + (*data)[0] + len;
-            b[0].len = bracket[0].len - (*data)[0] - len;
-            b[1].off = bracket[1].off + (*data)[1] + len;
-            b[1].len = bracket[1].len - (*data)[1] - len;
-            if (!hdiff_multi (s, t, b, min, hdiff, depth))
-                return FALSE;
-
-            g_array_free (ret, TRUE);
-            return TRUE;
         }
-    }
 
-    p[0].off = bracket[0].off;
-    p[0].len = bracket[0].len;
-    p[1].off = bracket[1].off;
-    p[1].len = bracket[1].len;
-    g_array_append_val (hdiff, p);
+        g_array_append_vals (trace, v + dmax + 1 - d, 2 * d + 1);
+    }
 
-    return TRUE;
+    g_free (v);
+    return -1;
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -1248,21 +1254,23 @@ hdiff_multi (const char *s, const char *t, const BRACKET bracket, int min, GArra
 /**
  * Build list of horizontal diff ranges.
  *
+ * Common prefix and suffix are skipped, then the rest is compared character by
+ * character.  Common substrings shorter than min don't split the ranges.  Too
+ * different lines are highlighted as one range.
+ *
  * \param s first string
  * \param m length of first string
  * \param t second string
  * \param n length of second string
  * \param min minimum length of common substrings
  * \param hdiff list of horizontal diff ranges to fill
- * \param depth recursion depth
- *
- * \return 0 if success, nonzero otherwise
  */
-static gboolean
-hdiff_scan (const char *s, int m, const char *t, int n, int min, GArray * hdiff, unsigned int depth)
+static void
+hdiff_scan (const char *s, int m, const char *t, int n, int min, GArray * hdiff)
 {
-    int i;
+    GArray *trace;
     BRACKET b;
+    int i, cost;
 
     /* dumbscan (single horizontal diff) -- does not compress whitespace */
     for (i = 0; i < m && i < n && s[i] == t[i]; i++)
@@ -1275,8 +1283,134 @@ hdiff_scan (const char *s, int m, const char *t, int n, int min, GArray * hdiff,
     b[1].off = i;
     b[1].len = n - i;
 
+    if (b[0].len == 0 || b[1].len == 0)
+    {
+        g_array_append_val (hdiff, b);
+        return;
+    }
+
     /* smartscan (multiple horizontal diff) */
-    return hdiff_multi (s, t, b, min, hdiff, depth);
+    trace = g_array_new (FALSE, FALSE, sizeof (int));
+    cost = hdiff_myers (s + i, b[0].len, t + i, b[1].len, trace);
+
+    if (cost < 0)
+        g_array_append_val (hdiff, b);
+    else
+    {
+        const int *tr = (const int *) trace->data;
+        int d, x, y;
+        int lo[2] = { 0, 0 }, hi[2] = { 0, 0 };
+        gboolean open = FALSE;
+
+        /* trace edit script back from the end, merging edits separated by short snakes */
+        x = b[0].len;
+        y = b[1].len;
+
+        for (d = cost; d > 0; d--)
+        {
+            /* points of cost d - 1 start at offset (d - 1)^2 */
+            const int *vp = tr + (d - 1) * (d - 1) + (d - 1);
+            int k, pk, px, mx, my;
+
+            k = x - y;
+            if (k == -d || (k != d && vp[k - 1] < vp[k + 1]))
+            {
+                /* insertion of t[py] */
+                pk = k + 1;
+                px = vp[pk];
+                mx = px;
+            }
+            else
+            {
+                /* deletion of s[px] */
+                pk = k - 1;
+                px = vp[pk];
+                mx = px + 1;
+            }
+            my = mx - k;
+
+            if (open && x - mx >= min)
+            {
+                BRACKET r;
+
+                r[0].off = i + lo[0];
+                r[0].len = hi[0] - lo[0];
+                r[1].off = i + lo[1];
+                r[1].len = hi[1] - lo[1];
+                g_array_append_val (hdiff, r);
+                open = FALSE;
+            }
+
+            if (!open)
+            {
+                hi[0] = mx;
+                hi[1] = my;
+                open = TRUE;
+            }
+
+            x = px;
+            y = px - pk;
+            lo[0] = x;
+            lo[1] = y;
+        }
+
+        if (open)
+        {
+            BRACKET r;
+
+            r[0].off = i + lo[0];
+            r[0].len = hi[0] - lo[0];
+            r[1].off = i + lo[1];
+            r[1].len = hi[1] - lo[1];
+            g_array_append_val (hdiff, r);
+        }
+    }
+
+    g_array_free (trace, TRUE);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/**
+ * Get list of horizontal diff ranges for the row.  The list is built when the
+ * row is shown first time and is kept until the diff is redone.
+ *
+ * \param dview WDiff widget
+ * \param i row number
+ *
+ * \return list of horizontal diff ranges, NULL if row is not changed
+ */
+static GArray *
+dview_get_hdiff (const WDiff * dview, size_t i)
+{
+    GArray *h;
+    DIFFLN p, q;
+
+    if (dview->hdiff == NULL)
+        return NULL;
+
+    h = (GArray *) g_hash_table_lookup (dview->hdiff, GSIZE_TO_POINTER (i));
+    if (h != NULL)
+        return h;
+
+    if (!dview_get_row (dview, 0, i, &p) || !dview_get_row (dview, 1, i, &q))
+        return NULL;
+    if (p.line == 0 || q.line == 0 || p.ch != CHG_CH || p.p == NULL || q.p == NULL)
+        return NULL;
+
+    h = g_array_new (FALSE, FALSE, sizeof (BRACKET));
+    hdiff_scan (p.p, (int) p.len, q.p, (int) q.len, HDIFF_MINCTX, h);
+    g_hash_table_insert (dview->hdiff, GSIZE_TO_POINTER (i), h);
+
+    return h;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+dview_free_hdiff (gpointer data)
+{
+    g_array_free ((GArray *) data, TRUE);
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -1714,80 +1848,18 @@ cvt_fget (FBUF * f, off_t off, char *dst, size_t dstsize, int skip, int ts, int
 }
 
 /* --------------------------------------------------------------------------------------------- */
-/* diff printers et al ****************************************************** */
-
-static void
-cc_free_elt (void *elt)
-{
-    DIFFLN *p = elt;
-    if (p != NULL)
-    {
-        g_free (p->p);
-    }
-}
-
-/* --------------------------------------------------------------------------------------------- */
-
-static int
-printer (void *ctx, int ch, int line, off_t off, size_t sz, const char *str)
-{
-    GArray *a = ((PRINTER_CTX *) ctx)->a;
-    DSRC dsrc = ((PRINTER_CTX *) ctx)->dsrc;
-    if (ch)
-    {
-        DIFFLN p;
-        p.p = NULL;
-        p.ch = ch;
-        p.line = line;
-        p.u.off = off;
-        if (dsrc == DATA_SRC_MEM && line != 0)
-        {
-            if (sz != 0 && str[sz - 1] == '\n')
-            {
-                sz--;
-            }
-            if (sz > 0)
-                p.p = g_strndup (str, sz);
-            p.u.len = sz;
-        }
-        g_array_append_val (a, p);
-    }
-    else if (dsrc == DATA_SRC_MEM)
-    {
-        DIFFLN *p;
-        p = &g_array_index (a, DIFFLN, a->len - 1);
-        if (sz != 0 && str[sz - 1] == '\n')
-        {
-            sz--;
-        }
-        if (sz != 0)
-        {
-            size_t new_size = p->u.len + sz;
-            char *q = g_realloc (p->p, new_size);
-            memcpy (q + p->u.len, str, sz);
-            p->p = q;
-        }
-        p->u.len += sz;
-    }
-    if (dsrc == DATA_SRC_TMP && (line != 0 || ch == 0))
-    {
-        FBUF *f = ((PRINTER_CTX *) ctx)->f;
-        f_write (f, str, sz);
-    }
-    return 0;
-}
-
-/* --------------------------------------------------------------------------------------------- */
+/* redo diff **************************************************************** */
 
 static int
 redo_diff (WDiff * dview)
 {
-    FBUF *const *f = dview->f;
-
-    PRINTER_CTX ctx;
     GArray *ops;
-    int ndiff;
-    int rv;
+    int ndiff = -1;
+    int ord;
+    gboolean ok = TRUE;
+    char *text[2] = { NULL, NULL };
+    size_t len[2] = { 0, 0 };
+    struct stat st[2];
 
     char extra[256];
 
@@ -1821,14 +1893,26 @@ redo_diff (WDiff * dview)
         strcat (extra, " -i");
     }
 
-    if (dview->dsrc != DATA_SRC_MEM)
+    ops = g_array_new (FALSE, FALSE, sizeof (DIFFCMD));
+
+    /* files are read once and compared in memory; external diff is used if it isn't possible */
+    if (strcmp (dview->args, "-a") == 0
+        && stat (dview->file[0], &st[0]) == 0 && stat (dview->file[1], &st[1]) == 0
+        && st[0].st_size < DIFF_BUILTIN_MAX_SIZE && st[1].st_size < DIFF_BUILTIN_MAX_SIZE
+        && g_file_get_contents (dview->file[0], &text[0], &len[0], NULL)
+        && g_file_get_contents (dview->file[1], &text[1], &len[1], NULL)
+        && len[0] < G_MAXINT && len[1] < G_MAXINT)
+        ndiff = dff_builtin (dview, text, len, ops);
+
+    if (ndiff < 0)
     {
-        f_reset (f[0]);
-        f_reset (f[1]);
+        g_free (text[0]);
+        g_free (text[1]);
+        text[0] = text[1] = NULL;
+        g_array_set_size (ops, 0);
+        ndiff = dff_execute (dview->args, extra, dview->file[0], dview->file[1], ops);
     }
 
-    ops = g_array_new (FALSE, FALSE, sizeof (DIFFCMD));
-    ndiff = dff_execute (dview->args, extra, dview->file[0], dview->file[1], ops);
     if (ndiff < 0)
     {
         if (ops != NULL)
@@ -1836,60 +1920,34 @@ redo_diff (WDiff * dview)
         return -1;
     }
 
-    ctx.dsrc = dview->dsrc;
+    /* files are reopened because they could be changed by editor or merge */
+    for (ord = 0; ord < 2; ord++)
+    {
+        if (dview->f[ord] != NULL)
+            f_close (dview->f[ord]);
+        dview->f[ord] = f_open (dview->file[ord], O_RDONLY);
+        if (dview->f[ord] == NULL
+            || !dview_index_file (&dview->lines->index[ord], dview->f[ord], text[ord], len[ord]))
+            ok = FALSE;
+    }
 
-    rv = 0;
-    ctx.a = dview->a[0];
-    ctx.f = f[0];
-    rv |= dff_reparse (0, dview->file[0], ops, printer, &ctx);
+    g_free (text[0]);
+    g_free (text[1]);
 
-    ctx.a = dview->a[1];
-    ctx.f = f[1];
-    rv |= dff_reparse (1, dview->file[1], ops, printer, &ctx);
+    dview_flush_lines (dview->lines);
 
-    if (ops != NULL)
-        g_array_free (ops, TRUE);
+    if (ok)
+        ok = dview_build_hunks (dview, ops);
 
-    if (rv != 0 || dview->a[0]->len != dview->a[1]->len)
-        return -1;
+    g_array_free (ops, TRUE);
 
-    if (dview->dsrc == DATA_SRC_TMP)
-    {
-        f_trunc (f[0]);
-        f_trunc (f[1]);
-    }
+    if (!ok)
+        return -1;
 
     if (dview->dsrc == DATA_SRC_MEM && HDIFF_ENABLE)
     {
-        dview->hdiff = g_ptr_array_new ();
-        if (dview->hdiff != NULL)
-        {
-            size_t i;
-            const DIFFLN *p;
-            const DIFFLN *q;
-            for (i = 0; i < dview->a[0]->len; i++)
-            {
-                GArray *h = NULL;
-                p = &g_array_index (dview->a[0], DIFFLN, i);
-                q = &g_array_index (dview->a[1], DIFFLN, i);
-                if (p->line && q->line && p->ch == CHG_CH)
-                {
-                    h = g_array_new (FALSE, FALSE, sizeof (BRACKET));
-                    if (h != NULL)
-                    {
-                        gboolean runresult =
-                            hdiff_scan (p->p, p->u.len, q->p, q->u.len, HDIFF_MINCTX, h,
-                                        HDIFF_DEPTH);
-                        if (!runresult)
-                        {
-                            g_array_free (h, TRUE);
-                            h = NULL;
-                        }
-                    }
-                }
-                g_ptr_array_add (dview->hdiff, h);
-            }
-        }
+        /* horizontal diffs are built on demand by dview_get_hdiff() */
+        dview->hdiff = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, dview_free_hdiff);
     }
     return ndiff;
 }
@@ -1901,15 +1959,7 @@ destroy_hdiff (WDiff * dview)
 {
     if (dview->hdiff != NULL)
     {
-        int i;
-        int len = dview->a[0]->len;
-        for (i = 0; i < len; i++)
-        {
-            GArray *h = (GArray *) g_ptr_array_index (dview->hdiff, i);
-            if (h != NULL)
-                g_array_free (h, TRUE);
-        }
-        g_ptr_array_free (dview->hdiff, TRUE);
+        g_hash_table_destroy (dview->hdiff);
         dview->hdiff = NULL;
     }
 
@@ -1936,37 +1986,31 @@ get_digits (unsigned int n)
 /* --------------------------------------------------------------------------------------------- */
 
 static int
-get_line_numbers (const GArray * a, size_t pos, int *linenum, int *lineofs)
+get_line_numbers (const WDiff * dview, int ord, size_t pos, int *linenum, int *lineofs)
 {
-    const DIFFLN *p;
+    const DIFFHUNK *h;
+    DIFFLN p;
 
     *linenum = 0;
     *lineofs = 0;
 
-    if (a->len != 0)
+    if (dview->nrows != 0)
     {
-        if (pos >= a->len)
+        if (pos >= dview->nrows)
         {
-            pos = a->len - 1;
+            pos = dview->nrows - 1;
         }
 
-        p = &g_array_index (a, DIFFLN, pos);
+        dview_get_row_info (dview, ord, pos, &p);
+        *linenum = p.line;
 
-        if (p->line == 0)
+        if (p.line == 0)
         {
-            int n;
-            for (n = pos; n > 0; n--)
-            {
-                p--;
-                if (p->line != 0)
-                {
-                    break;
-                }
-            }
-            *lineofs = pos - n + 1;
+            /* padding row: count it from the last line of hunk or from the line before hunk */
+            h = dview_find_hunk (dview, pos);
+            *linenum = h->line[ord] + h->len[ord] - 1;
+            *lineofs = pos - h->row - h->len[ord] + 1;
         }
-
-        *linenum = p->line;
     }
     return 0;
 }
@@ -1974,67 +2018,46 @@ get_line_numbers (const GArray * a, size_t pos, int *linenum, int *lineofs)
 /* --------------------------------------------------------------------------------------------- */
 
 static int
-calc_nwidth (const GArray ** const a)
+calc_nwidth (const WDiff * dview)
 {
-    int l1, o1;
-    int l2, o2;
-    get_line_numbers (a[0], a[0]->len - 1, &l1, &o1);
-    get_line_numbers (a[1], a[1]->len - 1, &l2, &o2);
-    if (l1 < l2)
-    {
-        l1 = l2;
-    }
-    return get_digits (l1);
+    return get_digits (max (dview->lines->index[0].lines, dview->lines->index[1].lines));
 }
 
 /* --------------------------------------------------------------------------------------------- */
 
-static int
-find_prev_hunk (const GArray * a, int pos)
+static size_t
+find_prev_hunk (const WDiff * dview, size_t pos)
 {
-#if 1
-    while (pos > 0 && ((DIFFLN *) & g_array_index (a, DIFFLN, pos))->ch != EQU_CH)
-    {
-        pos--;
-    }
-    while (pos > 0 && ((DIFFLN *) & g_array_index (a, DIFFLN, pos))->ch == EQU_CH)
-    {
-        pos--;
-    }
-    while (pos > 0 && ((DIFFLN *) & g_array_index (a, DIFFLN, pos))->ch != EQU_CH)
-    {
-        pos--;
-    }
-    if (pos > 0 && (size_t) pos < a->len)
-        pos++;
-#else
-    while (pos > 0 && ((DIFFLN *) & g_array_index (a, DIFFLN, pos - 1))->ch == EQU_CH)
-    {
-        pos--;
-    }
-    while (pos > 0 && ((DIFFLN *) & g_array_index (a, DIFFLN, pos - 1))->ch != EQU_CH)
+    const DIFFHUNK *h;
+
+    h = dview_find_hunk (dview, pos);
+    if (h == NULL)
+        return 0;
+
+    /* inside of hunk go to the previous one */
+    if (pos < h->row + dview_hunk_rows (h))
     {
-        pos--;
+        if (h == &g_array_index (dview->hunks, DIFFHUNK, 0))
+            return 0;
+        h--;
     }
-#endif
 
-    return pos;
+    return h->row;
 }
 
 /* --------------------------------------------------------------------------------------------- */
 
 static size_t
-find_next_hunk (const GArray * a, size_t pos)
+find_next_hunk (const WDiff * dview, size_t pos)
 {
-    while (pos < a->len && ((DIFFLN *) & g_array_index (a, DIFFLN, pos))->ch != EQU_CH)
-    {
-        pos++;
-    }
-    while (pos < a->len && ((DIFFLN *) & g_array_index (a, DIFFLN, pos))->ch == EQU_CH)
-    {
-        pos++;
-    }
-    return pos;
+    const DIFFHUNK *h;
+    size_t n = 0;
+
+    h = dview_find_hunk (dview, pos);
+    if (h != NULL)
+        n = h - &g_array_index (dview->hunks, DIFFHUNK, 0) + 1;
+
+    return n < dview->hunks->len ? g_array_index (dview->hunks, DIFFHUNK, n).row : dview->nrows;
 }
 
 /**
@@ -2050,10 +2073,7 @@ find_next_hunk (const GArray * a, size_t pos)
 static int
 get_current_hunk (WDiff * dview, int *start_line1, int *end_line1, int *start_line2, int *end_line2)
 {
-    const GArray *a0 = dview->a[0];
-    const GArray *a1 = dview->a[1];
-    size_t pos;
-    int ch;
+    const DIFFHUNK *h;
     int res = 0;
 
     *start_line1 = 1;
@@ -2061,43 +2081,27 @@ get_current_hunk (WDiff * dview, int *start_line1, int *end_line1, int *start_li
     *end_line1 = 1;
     *end_line2 = 1;
 
-    pos = dview->skip_rows;
-    ch = ((DIFFLN *) & g_array_index (a0, DIFFLN, pos))->ch;
-    if (ch != EQU_CH)
+    h = dview_find_hunk (dview, dview->skip_rows);
+    if (h != NULL && (size_t) dview->skip_rows < h->row + dview_hunk_rows (h))
     {
-        switch (ch)
+        switch (h->cmd)
         {
-        case ADD_CH:
+        case 'd':
             res = DIFF_DEL;
             break;
-        case DEL_CH:
+        case 'a':
             res = DIFF_ADD;
             break;
-        case CHG_CH:
+        case 'c':
             res = DIFF_CHG;
             break;
         }
-        while (pos > 0 && ((DIFFLN *) & g_array_index (a0, DIFFLN, pos))->ch != EQU_CH)
-        {
-            pos--;
-        }
-        if (pos > 0)
-        {
-            *start_line1 = ((DIFFLN *) & g_array_index (a0, DIFFLN, pos))->line + 1;
-            *start_line2 = ((DIFFLN *) & g_array_index (a1, DIFFLN, pos))->line + 1;
-        }
-        pos = dview->skip_rows;
-        while (pos < a0->len && ((DIFFLN *) & g_array_index (a0, DIFFLN, pos))->ch != EQU_CH)
-        {
-            int l0, l1;
-            l0 = ((DIFFLN *) & g_array_index (a0, DIFFLN, pos))->line;
-            l1 = ((DIFFLN *) & g_array_index (a1, DIFFLN, pos))->line;
-            if (l0 > 0)
-                *end_line1 = max (*start_line1, l0);
-            if (l1 > 0)
-                *end_line2 = max (*start_line2, l1);
-            pos++;
-        }
+        *start_line1 = h->line[0];
+        *start_line2 = h->line[1];
+        if (h->len[0] != 0)
+            *end_line1 = h->line[0] + h->len[0] - 1;
+        if (h->len[1] != 0)
+            *end_line2 = h->line[1] + h->len[1] - 1;
     }
     return res;
 }
@@ -2279,52 +2283,24 @@ dview_init (WDiff * dview, const char *args, const char *file1, const char *file
             const char *label1, const char *label2, DSRC dsrc)
 {
     int ndiff;
-    FBUF *f[2];
-
-    f[0] = NULL;
-    f[1] = NULL;
-
-    if (dsrc == DATA_SRC_TMP)
-    {
-        f[0] = f_temp ();
-        if (f[0] == NULL)
-            return -1;
-
-        f[1] = f_temp ();
-        if (f[1] == NULL)
-        {
-            f_close (f[0]);
-            return -1;
-        }
-    }
-    else if (dsrc == DATA_SRC_ORG)
-    {
-        f[0] = f_open (file1, O_RDONLY);
-        if (f[0] == NULL)
-            return -1;
-
-        f[1] = f_open (file2, O_RDONLY);
-        if (f[1] == NULL)
-        {
-            f_close (f[0]);
-            return -1;
-        }
-    }
 
     dview->args = args;
     dview->file[0] = file1;
     dview->file[1] = file2;
     dview->label[0] = g_strdup (label1);
     dview->label[1] = g_strdup (label2);
-    dview->f[0] = f[0];
-    dview->f[1] = f[1];
+    dview->f[0] = NULL;
+    dview->f[1] = NULL;
     dview->hdiff = NULL;
     dview->dsrc = dsrc;
     dview->converter = str_cnv_from_term;
     dview_set_codeset (dview);
 
-    dview->a[0] = g_array_new (FALSE, FALSE, sizeof (DIFFLN));
-    dview->a[1] = g_array_new (FALSE, FALSE, sizeof (DIFFLN));
+    dview->hunks = g_array_new (FALSE, FALSE, sizeof (DIFFHUNK));
+    dview->nrows = 0;
+    dview->lines = g_new0 (DIFFLINES, 1);
+    dview->lines->index[0].off = g_array_new (FALSE, FALSE, sizeof (off_t));
+    dview->lines->index[1].off = g_array_new (FALSE, FALSE, sizeof (off_t));
 
     ndiff = redo_diff (dview);
     if (ndiff < 0)
@@ -2373,19 +2349,6 @@ dview_reread (WDiff * dview)
     int ndiff = dview->ndiff;
 
     destroy_hdiff (dview);
-    if (dview->a[0] != NULL)
-    {
-        g_array_foreach (dview->a[0], DIFFLN, cc_free_elt);
-        g_array_free (dview->a[0], TRUE);
-    }
-    if (dview->a[1] != NULL)
-    {
-        g_array_foreach (dview->a[1], DIFFLN, cc_free_elt);
-        g_array_free (dview->a[1], TRUE);
-    }
-
-    dview->a[0] = g_array_new (FALSE, FALSE, sizeof (DIFFLN));
-    dview->a[1] = g_array_new (FALSE, FALSE, sizeof (DIFFLN));
 
     ndiff = redo_diff (dview);
     if (ndiff >= 0)
@@ -2441,27 +2404,27 @@ dview_diff_options (WDiff * dview)
 static void
 dview_fini (WDiff * dview)
 {
-    if (dview->dsrc != DATA_SRC_MEM)
-    {
-        f_close (dview->f[1]);
+    if (dview->f[0] != NULL)
         f_close (dview->f[0]);
-    }
+    if (dview->f[1] != NULL)
+        f_close (dview->f[1]);
 
     if (dview->converter != str_cnv_from_term)
         str_close_conv (dview->converter);
 
     destroy_hdiff (dview);
-    if (dview->a[0] != NULL)
+    if (dview->hunks != NULL)
     {
-        g_array_foreach (dview->a[0], DIFFLN, cc_free_elt);
-        g_array_free (dview->a[0], TRUE);
-        dview->a[0] = NULL;
+        g_array_free (dview->hunks, TRUE);
+        dview->hunks = NULL;
     }
-    if (dview->a[1] != NULL)
+    if (dview->lines != NULL)
     {
-        g_array_foreach (dview->a[1], DIFFLN, cc_free_elt);
-        g_array_free (dview->a[1], TRUE);
-        dview->a[1] = NULL;
+        dview_flush_lines (dview->lines);
+        g_array_free (dview->lines->index[0].off, TRUE);
+        g_array_free (dview->lines->index[1].off, TRUE);
+        g_free (dview->lines);
+        dview->lines = NULL;
     }
 
     g_free (dview->label[0]);
@@ -2477,13 +2440,13 @@ dview_display_file (const WDiff * dview, int ord, int r, int c, int height, int
     size_t i, k;
     int j;
     char buf[BUFSIZ];
-    FBUF *f = dview->f[ord];
     int skip = dview->skip_cols;
     int display_symbols = dview->display_symbols;
     int display_numbers = dview->display_numbers;
     int show_cr = dview->show_cr;
     int tab_size = 8;
-    const DIFFLN *p;
+    DIFFLN row;
+    const DIFFLN *p = &row;
     int nwidth = display_numbers;
     int xwidth = display_symbols + display_numbers;
     if (dview->tab_size > 0 && dview->tab_size < 9)
@@ -2519,11 +2482,11 @@ dview_display_file (const WDiff * dview, int ord, int r, int c, int height, int
         return -1;
     }
 
-    for (i = dview->skip_rows, j = 0; i < dview->a[ord]->len && j < height; j++, i++)
+    for (i = dview->skip_rows, j = 0; i < dview->nrows && j < height; j++, i++)
     {
         int ch, next_ch, col;
         size_t cnt;
-        p = (DIFFLN *) & g_array_index (dview->a[ord], DIFFLN, i);
+        dview_get_row (dview, ord, i, &row);
         ch = p->ch;
         tty_setcolor (NORMAL_COLOR);
         if (display_symbols)
@@ -2547,7 +2510,7 @@ dview_display_file (const WDiff * dview, int ord, int r, int c, int height, int
             {
                 tty_setcolor (DFF_CHG_COLOR);
             }
-            if (f == NULL)
+            if (dview->dsrc == DATA_SRC_MEM)
             {
                 if (i == (size_t) dview->search.last_found_line)
                 {
@@ -2555,15 +2518,17 @@ dview_display_file (const WDiff * dview, int ord, int r, int c, int height, int
                 }
                 else
                 {
-                    if (dview->hdiff != NULL && g_ptr_array_index (dview->hdiff, i) != NULL)
+                    GArray *h;
+
+                    h = dview_get_hdiff (dview, i);
+                    if (h != NULL)
                     {
                         char att[BUFSIZ];
                         if (dview->utf8)
                             k = dview_str_utf8_offset_to_pos (p->p, width);
                         else
                             k = width;
-                        cvt_mgeta (p->p, p->u.len, buf, k, skip, tab_size, show_cr,
-                                   g_ptr_array_index (dview->hdiff, i), ord, att);
+                        cvt_mgeta (p->p, p->len, buf, k, skip, tab_size, show_cr, h, ord, att);
                         tty_gotoyx (r + j, c);
                         col = 0;
                         for (cnt = 0; cnt < strlen (buf) && col < width; cnt++)
@@ -2615,11 +2580,11 @@ dview_display_file (const WDiff * dview, int ord, int r, int c, int height, int
                     k = dview_str_utf8_offset_to_pos (p->p, width);
                 else
                     k = width;
-                cvt_mget (p->p, p->u.len, buf, k, skip, tab_size, show_cr);
+                cvt_mget (p->p, p->len, buf, k, skip, tab_size, show_cr);
             }
             else
             {
-                cvt_fget (f, p->u.off, buf, width, skip, tab_size, show_cr);
+                cvt_fget (dview->f[ord], p->off, buf, width, skip, tab_size, show_cr);
             }
         }
         else
@@ -2718,7 +2683,7 @@ dview_status (const WDiff * dview, int ord, int width, int c)
     tty_setcolor (STATUSBAR_COLOR);
 
     tty_gotoyx (0, c);
-    get_line_numbers (dview->a[ord], dview->skip_rows, &linenum, &lineofs);
+    get_line_numbers (dview, ord, dview->skip_rows, &linenum, &lineofs);
 
     filename_width = width - 22;
     if (filename_width < 8)
@@ -2740,7 +2705,7 @@ dview_redo (WDiff * dview)
     if (dview->display_numbers)
     {
         int old = dview->display_numbers;
-        dview->display_numbers = calc_nwidth ((const GArray **) dview->a);
+        dview->display_numbers = calc_nwidth (dview);
         dview->new_frame = (old != dview->display_numbers);
     }
     dview_reread (dview);
@@ -2755,16 +2720,10 @@ dview_edit (WDiff * dview, int ord)
     gboolean h_modal;
     int linenum, lineofs;
 
-    if (dview->dsrc == DATA_SRC_TMP)
-    {
-        error_dialog (_("Edit"), _("Edit is disabled"));
-        return;
-    }
-
     h = ((Widget *) dview)->owner;
     h_modal = h->modal;
 
-    get_line_numbers (dview->a[ord], dview->skip_rows, &linenum, &lineofs);
+    get_line_numbers (dview, ord, dview->skip_rows, &linenum, &lineofs);
     h->modal = TRUE;            /* not allow edit file in several editors */
     do_edit_at_line (dview->file[ord], use_internal_edit, linenum);
     h->modal = h_modal;
@@ -2793,15 +2752,7 @@ dview_goto_cmd (WDiff * dview, int ord)
             size_t i = 0;
             if (newline > 0)
             {
-                const DIFFLN *p;
-                for (; i < dview->a[ord]->len; i++)
-                {
-                    p = &g_array_index (dview->a[ord], DIFFLN, i);
-                    if (p->line == newline)
-                    {
-                        break;
-                    }
-                }
+                i = dview_line_to_row (dview, ord, newline);
             }
             dview->skip_rows = dview->search.last_accessed_num_line = (ssize_t) i;
             g_snprintf (prev, sizeof (prev), "%d", newline);
@@ -2909,7 +2860,7 @@ dview_load_options (WDiff * dview)
         dview->display_symbols = 1;
     show_numbers = mc_config_get_bool (mc_main_config, "DiffView", "show_numbers", FALSE);
     if (show_numbers)
-        dview->display_numbers = calc_nwidth ((const GArray ** const) dview->a);
+        dview->display_numbers = calc_nwidth (dview);
     tab_size = mc_config_get_int (mc_main_config, "DiffView", "tab_size", 8);
     if (tab_size > 0 && tab_size < 9)
         dview->tab_size = tab_size;
@@ -2987,7 +2938,7 @@ dview_execute_cmd (WDiff * dview, unsigned long command)
         dview->new_frame = 1;
         break;
     case CK_ShowNumbers:
-        dview->display_numbers ^= calc_nwidth ((const GArray ** const) dview->a);
+        dview->display_numbers ^= calc_nwidth (dview);
         dview->new_frame = 1;
         break;
     case CK_SplitFull:
@@ -3036,11 +2987,11 @@ dview_execute_cmd (WDiff * dview, unsigned long command)
         break;
     case CK_HunkNext:
         dview->skip_rows = dview->search.last_accessed_num_line =
-            find_next_hunk (dview->a[0], dview->skip_rows);
+            find_next_hunk (dview, dview->skip_rows);
         break;
     case CK_HunkPrev:
         dview->skip_rows = dview->search.last_accessed_num_line =
-            find_prev_hunk (dview->a[0], dview->skip_rows);
+            find_prev_hunk (dview, dview->skip_rows);
         break;
     case CK_Goto:
         dview_goto_cmd (dview, TRUE);
@@ -3065,7 +3016,7 @@ dview_execute_cmd (WDiff * dview, unsigned long command)
         dview->skip_rows = dview->search.last_accessed_num_line = 0;
         break;
     case CK_Bottom:
-        dview->skip_rows = dview->search.last_accessed_num_line = dview->a[0]->len - 1;
+        dview->skip_rows = dview->search.last_accessed_num_line = dview->nrows - 1;
         break;
     case CK_Up:
         if (dview->skip_rows > 0)
@@ -3363,6 +3314,38 @@ do \
 } \
 while (0)
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Compare two files, local copies of non-local ones are used.
+ *
+ * @return 0 on success, negative on error
+ */
+
+int
+dview_diff_files (char *file0, char *file1)
+{
+    int rv = -1;
+    int use_copy0;
+    int use_copy1;
+    struct stat st0;
+    struct stat st1;
+    char *real_file0;
+    char *real_file1;
+
+    GET_FILE_AND_STAMP (0);
+    GET_FILE_AND_STAMP (1);
+    if (real_file0 != NULL && real_file1 != NULL)
+    {
+        rv = diff_view (real_file0, real_file1, file0, file1);
+    }
+    UNGET_FILE (1);
+    UNGET_FILE (0);
+
+    return rv;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
 void
 dview_diff_cmd (void)
 {
@@ -3371,6 +3354,7 @@ dview_diff_cmd (void)
     char *file1 = NULL;
     int is_dir0 = 0;
     int is_dir1 = 0;
+    gboolean dotdot = FALSE;
 
     if (mc_global.mc_run_mode == MC_RUN_FULL)
     {
@@ -3385,27 +3369,20 @@ dview_diff_cmd (void)
         file1 = concat_dir_and_file (panel1->cwd, selection (panel1)->fname);
         is_dir0 = S_ISDIR (selection (panel0)->st.st_mode);
         is_dir1 = S_ISDIR (selection (panel1)->st.st_mode);
+        /* don't compare whole parent trees */
+        dotdot = (strcmp (selection (panel0)->fname, "..") == 0
+                  || strcmp (selection (panel1)->fname, "..") == 0);
     }
 
     if (rv == 0)
     {
         rv = -1;
-        if (file0 != NULL && !is_dir0 && file1 != NULL && !is_dir1)
+        if (file0 != NULL && file1 != NULL)
         {
-            int use_copy0;
-            int use_copy1;
-            struct stat st0;
-            struct stat st1;
-            char *real_file0;
-            char *real_file1;
-            GET_FILE_AND_STAMP (0);
-            GET_FILE_AND_STAMP (1);
-            if (real_file0 != NULL && real_file1 != NULL)
-            {
-                rv = diff_view (real_file0, real_file1, file0, file1);
-            }
-            UNGET_FILE (1);
-            UNGET_FILE (0);
+            if (!is_dir0 && !is_dir1)
+                rv = dview_diff_files (file0, file1);
+            else if (is_dir0 && is_dir1 && !dotdot)
+                rv = dview_dir_diff (file0, file1);
         }
     }
 
@@ -3413,7 +3390,7 @@ dview_diff_cmd (void)
     g_free (file0);
 
     if (rv != 0)
-        message (1, MSG_ERROR, _("Two files are needed to compare"));
+        message (1, MSG_ERROR, _("Two files or two directories are needed to compare"));
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -3425,7 +3402,7 @@ dview_update (WDiff * dview)
     int width1;
     int width2;
 
-    int last = dview->a[0]->len - 1;
+    int last = dview->nrows - 1;
 
     if (dview->skip_rows > last)
     {
@@ -3503,3 +3480,40 @@ dview_update (WDiff * dview)
 }
 
 /* --------------------------------------------------------------------------------------------- */
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Get row of file.  Only hunks and line indexes are kept in memory, text of
+ * line is read when it is needed and cached for a while.
+ *
+ * \param dview WDiff widget
+ * \param ord 0 for first file, 1 for 2nd file
+ * \param row row number
+ * \param p row to fill
+ *
+ * \return TRUE if success, FALSE if there is no such row
+ */
+
+gboolean
+dview_get_row (const WDiff * dview, int ord, size_t row, DIFFLN * p)
+{
+    const DIFFCACHE *e;
+
+    if (row >= dview->nrows)
+        return FALSE;
+
+    dview_get_row_info (dview, ord, row, p);
+    if (p->line == 0)
+        return TRUE;
+
+    e = dview_get_line (dview, ord, p->line);
+    if (e != NULL)
+    {
+        p->off = e->off;
+        p->len = e->len;
+        p->p = e->p;
+    }
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
@@ -80,6 +80,7 @@
 #define COLUMN_OFF      609
 #define DELCHAR_BR      610
 #define BACKSPACE_BR    611
+#define TEXT_REPLACE    612     /* whole text is replaced, the previous one is saved aside */
 #define MARK_1          1000
 #define MARK_2          500000000
 #define MARK_CURS       1000000000
@@ -190,6 +191,8 @@ long edit_move_forward3 (WEdit * edit, long current, int cols, long upto);
 long edit_move_backward (WEdit * edit, long current, long lines);
 void edit_scroll_screen_over_cursor (WEdit * edit);
 void edit_render_keypress (WEdit * edit);
+void edit_render_cache_changed (WEdit * edit, long offset, long delta);
+void edit_render_cache_free (WEdit * edit);
 void edit_scroll_upward (WEdit * edit, unsigned long i);
 void edit_scroll_downward (WEdit * edit, int i);
 void edit_scroll_right (WEdit * edit, int i);
@@ -215,6 +218,7 @@ int edit_delete (WEdit * edit, const int byte_delete);
 void edit_insert (WEdit * edit, int c);
 void edit_cursor_move (WEdit * edit, long increment);
 void edit_push_undo_action (WEdit * edit, long c, ...);
+void edit_replace_text (WEdit * edit, const GString * text, long curs1);
 void edit_push_redo_action (WEdit * edit, long c, ...);
 void edit_push_key_press (WEdit * edit);
 void edit_insert_ahead (WEdit * edit, int c);
@@ -256,6 +260,7 @@ int eval_marks (WEdit * edit, long *start_mark, long *end_mark);
 void edit_status (WEdit * edit);
 void edit_execute_key_command (WEdit * edit, unsigned long command, int char_for_insertion);
 void edit_update_screen (WEdit * edit);
+GList *edit_get_all_editors (void);
 void edit_move_to_line (WEdit * e, long line);
 void edit_move_display (WEdit * e, long line);
 void edit_word_wrap (WEdit * edit);
@@ -285,6 +290,7 @@ void edit_set_filename (WEdit * edit, const char *name);
 void edit_load_syntax (WEdit * edit, char ***pnames, const char *type);
 void edit_free_syntax_rules (WEdit * edit);
 void edit_get_syntax_color (WEdit * edit, long byte_index, int *color);
+void edit_syntax_forget (WEdit * edit);
 
 void book_mark_insert (WEdit * edit, size_t line, int c);
 int book_mark_query_color (WEdit * edit, int line, int c);
@@ -297,6 +303,17 @@ void book_mark_dec (WEdit * edit, int line);
 void book_mark_serialize (WEdit * edit, int color);
 void book_mark_restore (WEdit * edit, int color);
 
+void edit_word_index_build (WEdit * edit);
+void edit_word_index_free (WEdit * edit);
+void edit_word_index_remove (WEdit * edit, long start, long end);
+void edit_word_index_add (WEdit * edit, long start, long end);
+GPtrArray *edit_word_index_lookup (WEdit * edit, const char *prefix, gsize prefix_len);
+
+void edit_line_index_free (WEdit * edit);
+void edit_line_index_update (WEdit * edit, gboolean after_cursor, long pos, int delta);
+long edit_line_index_count (WEdit * edit, long offset);
+long edit_line_index_find (WEdit * edit, long line);
+
 int line_is_blank (WEdit * edit, long line);
 int edit_indent_width (WEdit * edit, long p);
 void edit_insert_indent (WEdit * edit, int indent);
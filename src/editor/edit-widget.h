@@ -96,10 +96,18 @@ struct WEdit
     int caches_valid;
     int line_numbers[N_LINE_CACHES];
     long line_offsets[N_LINE_CACHES];
+    /* newline counts for long line lookups, NULL until first used */
+    struct _line_index *line_index;
 
     struct _book_mark *book_mark;
     GArray *serialized_bookmarks;
 
+    /* words of the buffer for word completion, NULL until first used */
+    struct _word_index *word_index;
+
+    /* rendered screen lines, NULL until first drawn */
+    struct _render_cache *render_cache;
+
     /* undo stack and pointers */
     unsigned long undo_stack_pointer;
     long *undo_stack;
@@ -107,6 +115,7 @@ struct WEdit
     unsigned long undo_stack_size_mask;
     unsigned long undo_stack_bottom;
     unsigned int undo_stack_disable:1;       /* If not 0, don't save events in the undo stack */
+    GSList *undo_texts;         /* texts replaced as a whole, for TEXT_REPLACE on the undo stack */
 
     unsigned long redo_stack_pointer;
     long *redo_stack;
@@ -114,6 +123,7 @@ struct WEdit
     unsigned long redo_stack_size_mask;
     unsigned long redo_stack_bottom;
     unsigned int redo_stack_reset:1;         /* If 1, need clear redo stack */
+    GSList *redo_texts;         /* texts replaced as a whole, for TEXT_REPLACE on the redo stack */
 
     struct stat stat1;          /* Result of mc_fstat() on the file */
     unsigned int skip_detach_prompt:1;  /* Do not prompt whether to detach a file anymore */
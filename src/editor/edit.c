@@ -110,8 +110,19 @@ const char VERTICAL_MAGIC[] = { '\1', '\1', '\1', '\1', '\n' };
 
 #define space_width 1
 
+/* longer line lookups use the line index instead of scanning the buffer */
+#define LINE_INDEX_MIN_BYTES (16 * 1024)
+#define LINE_INDEX_MIN_LINES 256
+
 /*** file scope type declarations ****************************************************************/
 
+/* text saved aside by edit_replace_text() for undo and redo */
+typedef struct
+{
+    GString *text;
+    long curs1;
+} edit_saved_text_t;
+
 /*** file scope variables ************************************************************************/
 
 /* detecting an error on save is easy: just check if every byte has been written. */
@@ -240,6 +251,117 @@ edit_init_buffers (WEdit * edit)
     edit->buffers2[0] = g_malloc0 (EDIT_BUF_SIZE);
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Copy the whole text from buffers.
+ */
+
+static GString *
+edit_get_text (WEdit * edit)
+{
+    GString *text;
+    long b, n;
+
+    text = g_string_sized_new (edit->last_byte);
+
+    for (b = 0; b * EDIT_BUF_SIZE < edit->curs1; b++)
+    {
+        n = min (EDIT_BUF_SIZE, edit->curs1 - b * EDIT_BUF_SIZE);
+        g_string_append_len (text, (char *) edit->buffers1[b], n);
+    }
+
+    /* text after cursor is stored backwards: its end is at the end of buffers2[0] */
+    for (b = edit->curs2 >> S_EDIT_BUF_SIZE; b >= 0; b--)
+    {
+        n = min (EDIT_BUF_SIZE, edit->curs2 - b * EDIT_BUF_SIZE);
+        if (n > 0)
+            g_string_append_len (text, (char *) edit->buffers2[b] + EDIT_BUF_SIZE - n, n);
+    }
+
+    return text;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Load text into buffers at once, replacing the current one.  Set cursor to curs1.
+ */
+
+static void
+edit_set_text (WEdit * edit, const GString * text, long curs1)
+{
+    long b, n;
+    long len = (long) text->len;
+
+    for (b = 0; b <= MAXBUFF; b++)
+    {
+        g_free (edit->buffers1[b]);
+        g_free (edit->buffers2[b]);
+    }
+    edit_init_buffers (edit);
+
+    edit->last_byte = len;
+    edit->curs1 = curs1;
+    edit->curs2 = len - curs1;
+
+    for (b = 0; b * EDIT_BUF_SIZE < edit->curs1; b++)
+    {
+        n = min (EDIT_BUF_SIZE, edit->curs1 - b * EDIT_BUF_SIZE);
+        edit->buffers1[b] = g_malloc0 (EDIT_BUF_SIZE);
+        memcpy (edit->buffers1[b], text->str + b * EDIT_BUF_SIZE, n);
+    }
+
+    /* edit->buffers2[0] is already allocated */
+    for (b = 0; b <= edit->curs2 >> S_EDIT_BUF_SIZE; b++)
+    {
+        n = min (EDIT_BUF_SIZE, edit->curs2 - b * EDIT_BUF_SIZE);
+        if (edit->buffers2[b] == NULL)
+            edit->buffers2[b] = g_malloc0 (EDIT_BUF_SIZE);
+        memcpy (edit->buffers2[b] + EDIT_BUF_SIZE - n, text->str + len - b * EDIT_BUF_SIZE - n, n);
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+edit_free_saved_texts (GSList ** texts)
+{
+    GSList *iter;
+
+    for (iter = *texts; iter != NULL; iter = g_slist_next (iter))
+    {
+        edit_saved_text_t *saved = (edit_saved_text_t *) iter->data;
+
+        g_string_free (saved->text, TRUE);
+        g_free (saved);
+    }
+
+    g_slist_free (*texts);
+    *texts = NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Put back the text saved by the last TEXT_REPLACE action.
+ */
+
+static void
+edit_restore_text (WEdit * edit, GSList ** texts)
+{
+    edit_saved_text_t *saved;
+
+    /* text is lost if the stack has wrapped round */
+    if (*texts == NULL)
+        return;
+
+    saved = (edit_saved_text_t *) (*texts)->data;
+    *texts = g_slist_delete_link (*texts, *texts);
+
+    edit_replace_text (edit, saved->text, saved->curs1);
+
+    g_string_free (saved->text, TRUE);
+    g_free (saved);
+}
+
 /* --------------------------------------------------------------------------------------------- */
 /**
  * Load file OR text into buffers.  Set cursor to the beginning of file.
@@ -759,6 +881,10 @@ edit_backspace (WEdit * edit, const int byte_delete)
         if (cw < 1)
             cw = 1;
     }
+
+    edit_word_index_remove (edit, edit->curs1 - cw, edit->curs1);
+    edit_render_cache_changed (edit, edit->curs1 - cw, -cw);
+
     for (i = 1; i <= cw; i++)
     {
         if (edit->mark1 >= edit->curs1)
@@ -773,6 +899,8 @@ edit_backspace (WEdit * edit, const int byte_delete)
 
         p = *(edit->buffers1[(edit->curs1 - 1) >> S_EDIT_BUF_SIZE] +
               ((edit->curs1 - 1) & M_EDIT_BUF_SIZE));
+        if (p == '\n')
+            edit_line_index_update (edit, FALSE, edit->curs1 - 1, -1);
         if (!((edit->curs1 - 1) & M_EDIT_BUF_SIZE))
         {
             g_free (edit->buffers1[edit->curs1 >> S_EDIT_BUF_SIZE]);
@@ -782,6 +910,7 @@ edit_backspace (WEdit * edit, const int byte_delete)
         edit->curs1--;
         edit_push_undo_action (edit, p);
     }
+    edit_word_index_add (edit, edit->curs1, edit->curs1);
     edit_modification (edit);
     if (p == '\n')
     {
@@ -1341,6 +1470,9 @@ edit_do_undo (WEdit * edit)
         case COLUMN_OFF:
             edit->column_highlight = 0;
             break;
+        case TEXT_REPLACE:
+            edit_restore_text (edit, &edit->undo_texts);
+            break;
         }
         if (ac >= 256 && ac < 512)
             edit_insert_ahead (edit, ac - 256);
@@ -1416,6 +1548,9 @@ edit_do_redo (WEdit * edit)
         case COLUMN_OFF:
             edit->column_highlight = 0;
             break;
+        case TEXT_REPLACE:
+            edit_restore_text (edit, &edit->redo_texts);
+            break;
         }
         if (ac >= 256 && ac < 512)
             edit_insert_ahead (edit, ac - 256);
@@ -2307,6 +2442,9 @@ edit_clean (WEdit * edit)
         unlink (edit->filename);
 
     edit_free_syntax_rules (edit);
+    edit_word_index_free (edit);
+    edit_render_cache_free (edit);
+    edit_line_index_free (edit);
     book_mark_flush (edit, -1);
     for (; j <= MAXBUFF; j++)
     {
@@ -2316,6 +2454,8 @@ edit_clean (WEdit * edit)
 
     g_free (edit->undo_stack);
     g_free (edit->redo_stack);
+    edit_free_saved_texts (&edit->undo_texts);
+    edit_free_saved_texts (&edit->redo_texts);
     g_free (edit->filename);
     g_free (edit->dir);
     mc_search_free (edit->search);
@@ -2425,6 +2565,8 @@ edit_set_codeset (WEdit * edit)
             if (edit->converter != str_cnv_from_term)
                 str_close_conv (edit->converter);
             edit->converter = conv;
+            /* new converter may get the address of the closed one */
+            edit_render_cache_free (edit);
         }
     }
 
@@ -2510,6 +2652,7 @@ edit_push_undo_action (WEdit * edit, long c, ...)
     else if (edit->redo_stack_reset)
     {
         edit->redo_stack_bottom = edit->redo_stack_pointer = 0;
+        edit_free_saved_texts (&edit->redo_texts);
     }
 
     if (edit->undo_stack_bottom != sp
@@ -2654,6 +2797,53 @@ edit_push_redo_action (WEdit * edit, long c, ...)
 
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Replace the whole text at once.  The previous text is saved aside, so only one
+ * TEXT_REPLACE action is pushed onto the undo stack instead of an action per byte.
+ *
+ * @param edit editor object
+ * @param text new text
+ * @param curs1 cursor position in the new text
+ */
+
+void
+edit_replace_text (WEdit * edit, const GString * text, long curs1)
+{
+    edit_saved_text_t *saved;
+
+    saved = g_new (edit_saved_text_t, 1);
+    saved->text = edit_get_text (edit);
+    saved->curs1 = edit->curs1;
+
+    /* may clear the redo stack together with its saved texts */
+    edit_push_undo_action (edit, TEXT_REPLACE);
+    if (edit->undo_stack_disable)
+        edit->redo_texts = g_slist_prepend (edit->redo_texts, saved);
+    else
+        edit->undo_texts = g_slist_prepend (edit->undo_texts, saved);
+
+    edit_word_index_free (edit);
+    edit_render_cache_free (edit);
+    edit_line_index_free (edit);
+    edit_syntax_forget (edit);
+
+    edit_set_text (edit, text, min (curs1, (long) text->len));
+    edit_modification (edit);
+
+    edit->mark1 = min (edit->mark1, edit->last_byte);
+    edit->mark2 = min (edit->mark2, edit->last_byte);
+    edit->end_mark_curs = min (edit->end_mark_curs, edit->last_byte);
+    edit->bracket = -1;
+    edit->over_col = 0;
+
+    edit->total_lines = edit_count_lines (edit, 0, edit->last_byte);
+    edit->curs_line = edit_count_lines (edit, 0, edit->curs1);
+    edit->start_display = edit_bol (edit, min (edit->start_display, edit->last_byte));
+    edit->start_line = edit_count_lines (edit, 0, edit->start_display);
+    edit->force |= REDRAW_PAGE;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 /**
    Basic low level single character buffer alterations and movements at the cursor.
@@ -2702,6 +2892,9 @@ edit_insert (WEdit * edit, int c)
     edit->mark2 += (edit->mark2 > edit->curs1);
     edit->last_get_rule += (edit->last_get_rule > edit->curs1);
 
+    edit_word_index_remove (edit, edit->curs1, edit->curs1);
+    edit_render_cache_changed (edit, edit->curs1, 1);
+
     /* add a new buffer if we've reached the end of the last one */
     if (!(edit->curs1 & M_EDIT_BUF_SIZE))
         edit->buffers1[edit->curs1 >> S_EDIT_BUF_SIZE] = g_malloc0 (EDIT_BUF_SIZE);
@@ -2709,12 +2902,16 @@ edit_insert (WEdit * edit, int c)
     /* perform the insertion */
     edit->buffers1[edit->curs1 >> S_EDIT_BUF_SIZE][edit->curs1 & M_EDIT_BUF_SIZE]
         = (unsigned char) c;
+    if (c == '\n')
+        edit_line_index_update (edit, FALSE, edit->curs1, 1);
 
     /* update file length */
     edit->last_byte++;
 
     /* update cursor position */
     edit->curs1++;
+
+    edit_word_index_add (edit, edit->curs1 - 1, edit->curs1);
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -2750,13 +2947,20 @@ edit_insert_ahead (WEdit * edit, int c)
     edit->mark2 += (edit->mark2 >= edit->curs1);
     edit->last_get_rule += (edit->last_get_rule >= edit->curs1);
 
+    edit_word_index_remove (edit, edit->curs1, edit->curs1);
+    edit_render_cache_changed (edit, edit->curs1, 1);
+
     if (!((edit->curs2 + 1) & M_EDIT_BUF_SIZE))
         edit->buffers2[(edit->curs2 + 1) >> S_EDIT_BUF_SIZE] = g_malloc0 (EDIT_BUF_SIZE);
     edit->buffers2[edit->curs2 >> S_EDIT_BUF_SIZE]
         [EDIT_BUF_SIZE - (edit->curs2 & M_EDIT_BUF_SIZE) - 1] = c;
+    if (c == '\n')
+        edit_line_index_update (edit, TRUE, edit->curs2, 1);
 
     edit->last_byte++;
     edit->curs2++;
+
+    edit_word_index_add (edit, edit->curs1, edit->curs1 + 1);
 }
 
 
@@ -2784,6 +2988,9 @@ edit_delete (WEdit * edit, const int byte_delete)
     if (edit->mark2 != edit->mark1)
         edit_push_markers (edit);
 
+    edit_word_index_remove (edit, edit->curs1, edit->curs1 + cw);
+    edit_render_cache_changed (edit, edit->curs1, -cw);
+
     for (i = 1; i <= cw; i++)
     {
         if (edit->mark1 > edit->curs1)
@@ -2799,6 +3006,8 @@ edit_delete (WEdit * edit, const int byte_delete)
         p = edit->buffers2[(edit->curs2 - 1) >> S_EDIT_BUF_SIZE][EDIT_BUF_SIZE -
                                                                  ((edit->curs2 -
                                                                    1) & M_EDIT_BUF_SIZE) - 1];
+        if (p == '\n')
+            edit_line_index_update (edit, TRUE, edit->curs2 - 1, -1);
 
         if (!(edit->curs2 & M_EDIT_BUF_SIZE))
         {
@@ -2810,6 +3019,7 @@ edit_delete (WEdit * edit, const int byte_delete)
         edit_push_undo_action (edit, p + 256);
     }
 
+    edit_word_index_add (edit, edit->curs1, edit->curs1);
     edit_modification (edit);
     if (p == '\n')
     {
@@ -2862,6 +3072,8 @@ edit_cursor_move (WEdit * edit, long increment)
             edit->curs1--;
             if (c == '\n')
             {
+                edit_line_index_update (edit, FALSE, edit->curs1, -1);
+                edit_line_index_update (edit, TRUE, edit->curs2 - 1, 1);
                 edit->curs_line--;
                 edit->force |= REDRAW_LINE_BELOW;
             }
@@ -2893,6 +3105,8 @@ edit_cursor_move (WEdit * edit, long increment)
             edit->curs2--;
             if (c == '\n')
             {
+                edit_line_index_update (edit, FALSE, edit->curs1 - 1, 1);
+                edit_line_index_update (edit, TRUE, edit->curs2, -1);
                 edit->curs_line++;
                 edit->force |= REDRAW_LINE_ABOVE;
             }
@@ -2942,6 +3156,8 @@ edit_count_lines (WEdit * edit, long current, long upto)
         upto = edit->last_byte;
     if (current < 0)
         current = 0;
+    if (upto - current > LINE_INDEX_MIN_BYTES)
+        return edit_line_index_count (edit, upto) - edit_line_index_count (edit, current);
     while (current < upto)
         if (edit_get_byte (edit, current++) == '\n')
             lines++;
@@ -2964,6 +3180,8 @@ edit_move_forward (WEdit * edit, long current, long lines, long upto)
         long next;
         if (lines < 0)
             lines = 0;
+        if (lines > LINE_INDEX_MIN_LINES)
+            return edit_line_index_find (edit, edit_line_index_count (edit, current) + lines);
         while (lines--)
         {
             next = edit_eol (edit, current) + 1;
@@ -2984,6 +3202,8 @@ edit_move_backward (WEdit * edit, long current, long lines)
 {
     if (lines < 0)
         lines = 0;
+    if (lines > LINE_INDEX_MIN_LINES)
+        return edit_line_index_find (edit, max (edit_line_index_count (edit, current) - lines, 0));
     current = edit_bol (edit, current);
     while ((lines--) && current != 0)
         current = edit_bol (edit, current - 1);
@@ -100,6 +100,14 @@ int edit_confirm_save = 1;
 
 /*** file scope type declarations ****************************************************************/
 
+/* match found by "replace all" */
+typedef struct
+{
+    long offset;
+    long len;
+    GString *repl;              /* replacement text */
+} edit_replace_match_t;
+
 /*** file scope variables ************************************************************************/
 
 /*** file scope functions ************************************************************************/
@@ -770,6 +778,139 @@ editcmd_find (WEdit * edit, gsize * len)
 
 /* --------------------------------------------------------------------------------------------- */
 
+static void
+edit_replace_match_free (edit_replace_match_t * m)
+{
+    g_string_free (m->repl, TRUE);
+    g_free (m);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Replace all occurrences forward from edit->search_start in one pass.
+ * All matches are found first, then the new text is built from them and swapped in
+ * as the buffer contents, so the whole replacement is a single undo action.
+ *
+ * @param edit editor object
+ * @param replace_tpl replacement string (may contain backreferences)
+ *
+ * @return number of replacements made or -1 on error
+ */
+
+static long
+edit_replace_all_bulk (WEdit * edit, const char *replace_tpl)
+{
+    long start_mark = 0;
+    long end_mark = edit->last_byte;
+    long search_start;
+    long times_replaced = 0;
+    long delta = 0;
+    GString *tpl_str;
+    GSList *matches = NULL;     /* the last match first */
+    GSList *iter;
+
+    if (edit_search_options.only_in_selection && eval_marks (edit, &start_mark, &end_mark) != 0)
+        return 0;
+
+    search_start = edit->search_start;
+    if (search_start < start_mark)
+        search_start = start_mark;
+
+    tpl_str = g_string_new (replace_tpl);
+
+    while (search_start < end_mark)
+    {
+        gsize len = 0;
+        long found;
+        edit_replace_match_t *m;
+
+        if (!mc_search_run (edit->search, (void *) edit, search_start, end_mark, &len))
+            break;
+
+        found = (long) edit->search->normal_offset;
+        if (found < search_start || found >= end_mark)
+            break;
+
+        m = g_new (edit_replace_match_t, 1);
+        m->offset = found;
+        m->len = (long) len;
+        /* must be done right after the search: backreferences refer to the last match */
+        m->repl = mc_search_prepare_replace_str (edit->search, tpl_str);
+        if (edit->search->error != MC_SEARCH_E_OK)
+        {
+            edit_error_dialog (_("Replace"), edit->search->error_str);
+            edit_replace_match_free (m);
+            times_replaced = -1;
+            break;
+        }
+
+        /* the rest is left as is if the text grows too much */
+        if (edit->last_byte + delta + (long) m->repl->len - m->len >= SIZE_LIMIT)
+        {
+            edit_replace_match_free (m);
+            break;
+        }
+
+        matches = g_slist_prepend (matches, m);
+        times_replaced++;
+        delta += (long) m->repl->len - m->len;
+
+        /* so that we don't find the same empty string again */
+        search_start = (len == 0) ? found + 1 : found + (long) len;
+    }
+
+    if (times_replaced > 0)
+    {
+        GString *text;
+        long offset = 0;
+        long mark1 = edit->mark1, mark2 = edit->mark2;
+
+        text = g_string_sized_new (edit->last_byte + delta);
+        matches = g_slist_reverse (matches);
+
+        for (iter = matches; iter != NULL; iter = g_slist_next (iter))
+        {
+            edit_replace_match_t *m = (edit_replace_match_t *) iter->data;
+            long shift = (long) m->repl->len - m->len;
+
+            for (; offset < m->offset; offset++)
+                g_string_append_c (text, edit_get_byte (edit, offset));
+
+            /* highlight the last replacement */
+            edit->found_start = (long) text->len;
+            edit->found_len = (int) m->repl->len;
+
+            g_string_append_len (text, m->repl->str, m->repl->len);
+            offset += m->len;
+
+            /* keep the selection around the replaced text */
+            if (edit->mark1 >= offset)
+                mark1 += shift;
+            if (edit->mark2 >= offset)
+                mark2 += shift;
+        }
+
+        for (; offset < edit->last_byte; offset++)
+            g_string_append_c (text, edit_get_byte (edit, offset));
+
+        edit_push_key_press (edit);
+        edit_replace_text (edit, text, edit->found_start + edit->found_len);
+        g_string_free (text, TRUE);
+
+        edit->mark1 = mark1;
+        edit->mark2 = mark2;
+        edit->search_start = edit->curs1;
+    }
+
+    g_slist_foreach (matches, (GFunc) edit_replace_match_free, NULL);
+    g_slist_free (matches);
+    g_string_free (tpl_str, TRUE);
+
+    return times_replaced;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
 static char *
 edit_replace_cmd__conv_to_display (char *str)
 {
@@ -1059,6 +1200,183 @@ edit_collect_completions_get_current_word (WEdit * edit, mc_search_t * srch, lon
     return g_string_free (temp, temp->len == 0);
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Append word to the list of completions if it isn't there yet.
+ * The word under cursor is never added.
+ */
+
+static void
+edit_completion_add_word (GPtrArray * words, char *word, const char *current_word)
+{
+    guint i;
+
+    if (strcmp (word, current_word) == 0)
+        return;
+
+    for (i = 0; i < words->len; i++)
+        if (strcmp ((char *) g_ptr_array_index (words, i), word) == 0)
+            return;
+
+    g_ptr_array_add (words, word);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Find TAGS file in the current directory or in one of its parents.
+ *
+ * @param path where to store the directory of TAGS file. Must be g_free'd
+ *
+ * @return newly allocated name of TAGS file or NULL if it is not found
+ */
+
+static char *
+edit_find_tags_file (char **path)
+{
+    char *ptr;
+    char *tagfile = NULL;
+
+    ptr = g_get_current_dir ();
+    *path = g_strconcat (ptr, G_DIR_SEPARATOR_S, (char *) NULL);
+    g_free (ptr);
+
+    /* Recursive search file 'TAGS' in parent dirs */
+    do
+    {
+        ptr = g_path_get_dirname (*path);
+        g_free (*path);
+        *path = ptr;
+        g_free (tagfile);
+        tagfile = mc_build_filename (*path, TAGS_NAME, (char *) NULL);
+        if (exist_file (tagfile))
+            return tagfile;
+    }
+    while (strcmp (*path, G_DIR_SEPARATOR_S) != 0);
+
+    g_free (tagfile);
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Collect the possible completions from the word index of the whole buffer,
+ * optionally from other editors and from the TAGS file.
+ * The most frequent words are put to the end of list, they are shown first.
+ */
+
+static gsize
+edit_collect_completions_indexed (WEdit * edit, long word_start, gsize word_len,
+                                  struct selection *compl, gsize * num)
+{
+    gsize max_len = 0;
+    guint i, n;
+    long p;
+    GString *current_word;
+    GPtrArray *words;
+    GPtrArray *symbols = NULL;
+
+    /* whole word under cursor: prefix and the rest of word after cursor */
+    current_word = g_string_sized_new (word_len);
+    for (p = word_start; p < edit->last_byte; p++)
+    {
+        int c;
+
+        c = edit_get_byte (edit, p);
+        if ((gsize) (p - word_start) >= word_len && is_break_char (c))
+            break;
+        g_string_append_c (current_word, c);
+    }
+
+    words = edit_word_index_lookup (edit, current_word->str, word_len);
+
+    /* skip the word under cursor itself */
+    for (i = 0, n = 0; i < words->len && n < MAX_WORD_COMPLETIONS; i++)
+        if (strcmp ((char *) g_ptr_array_index (words, i), current_word->str) != 0)
+            g_ptr_array_index (words, n++) = g_ptr_array_index (words, i);
+    g_ptr_array_set_size (words, n);
+
+    /* words of other open editors: less relevant ones, so they are added after own words.
+       Words are owned by indexes of those editors which aren't modified while completing */
+    if (n < MAX_WORD_COMPLETIONS
+        && mc_config_get_bool (mc_main_config, CONFIG_APP_SECTION,
+                               "editor_wordcompletion_collect_other_editors", 0))
+    {
+        GList *editors, *e;
+
+        editors = edit_get_all_editors ();
+
+        for (e = editors; e != NULL && words->len < MAX_WORD_COMPLETIONS; e = g_list_next (e))
+        {
+            WEdit *other = (WEdit *) e->data;
+            GPtrArray *other_words;
+
+            if (other == edit)
+                continue;
+
+            other_words = edit_word_index_lookup (other, current_word->str, word_len);
+            for (i = 0; i < other_words->len && words->len < MAX_WORD_COMPLETIONS; i++)
+                edit_completion_add_word (words, (char *) g_ptr_array_index (other_words, i),
+                                          current_word->str);
+            g_ptr_array_free (other_words, TRUE);
+        }
+
+        g_list_free (editors);
+        n = words->len;
+    }
+
+    /* symbols from TAGS file follow the words of buffers */
+    if (n < MAX_WORD_COMPLETIONS
+        && mc_config_get_bool (mc_main_config, CONFIG_APP_SECTION,
+                               "editor_wordcompletion_use_tags", 0))
+    {
+        char *path = NULL;
+        char *tags_file;
+
+        tags_file = edit_find_tags_file (&path);
+        symbols = etags_get_symbols (tags_file, current_word->str, word_len,
+                                     MAX_WORD_COMPLETIONS);
+        g_free (tags_file);
+        g_free (path);
+
+        for (i = 0; symbols != NULL && i < symbols->len && words->len < MAX_WORD_COMPLETIONS; i++)
+            edit_completion_add_word (words, (char *) g_ptr_array_index (symbols, i),
+                                      current_word->str);
+        n = words->len;
+    }
+
+    for (*num = 0; *num < n; (*num)++)
+    {
+        GString *temp;
+
+        temp = g_string_new ((char *) g_ptr_array_index (words, n - 1 - *num));
+#ifdef HAVE_CHARSET
+        {
+            GString *recoded;
+            recoded = str_convert_to_display (temp->str);
+
+            if (recoded && recoded->len)
+                g_string_assign (temp, recoded->str);
+
+            g_string_free (recoded, TRUE);
+        }
+#endif
+        if (temp->len > max_len)
+            max_len = temp->len;
+        compl[*num].len = temp->len;
+        compl[*num].text = g_string_free (temp, FALSE);
+    }
+
+    g_ptr_array_free (words, TRUE);
+    if (symbols != NULL)
+    {
+        g_ptr_array_foreach (symbols, (GFunc) g_free, NULL);
+        g_ptr_array_free (symbols, TRUE);
+    }
+    g_string_free (current_word, TRUE);
+
+    return max_len;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 /** collect the possible completions */
 
@@ -1075,19 +1393,16 @@ edit_collect_completions (WEdit * edit, long word_start, gsize word_len,
     long last_byte, start = -1;
     char *current_word;
 
+    /* words of the whole file are taken from the index */
+    if (mc_config_get_bool
+        (mc_main_config, CONFIG_APP_SECTION, "editor_wordcompletion_collect_entire_file", 0))
+        return edit_collect_completions_indexed (edit, word_start, word_len, compl, num);
+
     srch = mc_search_new (match_expr, -1);
     if (srch == NULL)
         return 0;
 
-    if (mc_config_get_bool
-        (mc_main_config, CONFIG_APP_SECTION, "editor_wordcompletion_collect_entire_file", 0))
-    {
-        last_byte = edit->last_byte;
-    }
-    else
-    {
-        last_byte = word_start;
-    }
+    last_byte = word_start;
 
     srch->search_type = MC_SEARCH_T_REGEX;
     srch->is_case_sensitive = TRUE;
@@ -2392,6 +2707,17 @@ edit_replace_cmd (WEdit * edit, int again)
                 }
             }
 
+            if (edit->replace_mode == 1 && !edit_search_options.backwards)
+            {
+                long n;
+
+                /* no more prompts: replace the rest in a single pass */
+                n = edit_replace_all_bulk (edit, input2);
+                if (n > 0)
+                    times_replaced += n;
+                break;          /* loop */
+            }
+
             /* don't process string each time */
             tmp_str = g_string_new (input2);
             repl_str = mc_search_prepare_replace_str (edit->search, tmp_str);
@@ -3192,7 +3518,6 @@ edit_get_match_keyword_cmd (WEdit * edit)
     unsigned char *bufpos;
     char *match_expr;
     char *path = NULL;
-    char *ptr = NULL;
     char *tagfile = NULL;
 
     etags_hash_t def_hash[MAX_DEFINITIONS];
@@ -3210,23 +3535,7 @@ edit_get_match_keyword_cmd (WEdit * edit)
     bufpos = &edit->buffers1[word_start >> S_EDIT_BUF_SIZE][word_start & M_EDIT_BUF_SIZE];
     match_expr = g_strdup_printf ("%.*s", (int) word_len, bufpos);
 
-    ptr = g_get_current_dir ();
-    path = g_strconcat (ptr, G_DIR_SEPARATOR_S, (char *) NULL);
-    g_free (ptr);
-
-    /* Recursive search file 'TAGS' in parent dirs */
-    do
-    {
-        ptr = g_path_get_dirname (path);
-        g_free (path);
-        path = ptr;
-        g_free (tagfile);
-        tagfile = mc_build_filename (path, TAGS_NAME, (char *) NULL);
-        if (exist_file (tagfile))
-            break;
-    }
-    while (strcmp (path, G_DIR_SEPARATOR_S) != 0);
-
+    tagfile = edit_find_tags_file (&path);
     if (tagfile)
     {
         num_def =
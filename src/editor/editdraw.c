@@ -85,6 +85,8 @@ int visible_tabs = 1, visible_tws = 1;
 
 #define EDITOR_MINIMUM_TERMINAL_WIDTH 30
 
+/* more changes of buffer between two redraws drop the whole render cache */
+#define RENDER_CACHE_MAX_CHANGES 256
 
 /*** file scope type declarations ****************************************************************/
 
@@ -94,6 +96,53 @@ struct line_s
     unsigned int style;
 };
 
+/* everything but the text of line that has an effect on the rendered line */
+typedef struct
+{
+    long start_col;
+    long end_col;
+    long edit_start_col;
+    /* marked, found and bracket positions relative to the beginning of line, -1 if not in line */
+    long mark_start;
+    long mark_end;
+    long column1;
+    long column2;
+    long found_start;
+    long found_end;
+    long bracket;
+    int book_mark;
+    /* highlighting state at the beginning of line */
+    struct syntax_rule rule;
+    /* options */
+    int tab_size;
+    int show_tabs;
+    int show_tws;
+    gboolean highlight;
+    gboolean utf8;
+    gboolean utf8_display;
+    GIConv converter;
+} render_key_t;
+
+typedef struct
+{
+    long b;                     /* beginning of line, -1 if entry is free */
+    long eol;                   /* end of line */
+    unsigned int frame;         /* last redraw that used this entry */
+    render_key_t key;
+    long start_col;
+    long start_col_real;
+    struct line_s *cells;       /* terminated with ch == '\0' */
+    size_t size;                /* allocated number of cells */
+} render_line_t;
+
+struct _render_cache
+{
+    unsigned int frame;         /* number of redraws */
+    unsigned int changes;       /* changes of buffer since last redraw */
+    render_line_t *lines;
+    int num;
+};
+
 /*** file scope variables ************************************************************************/
 
 /*** file scope functions ************************************************************************/
@@ -321,6 +370,150 @@ print_to_widget (WEdit * edit, long row, int start_col, int start_col_real,
     }
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/** Get part of [start, end) range that is in the line [b, eol] relative to b */
+
+static void
+render_clip (long start, long end, long b, long eol, long *rstart, long *rend)
+{
+    if (start < end && start <= eol && end > b)
+    {
+        *rstart = max (start, b) - b;
+        *rend = min (end, eol + 1) - b;
+    }
+    else
+    {
+        *rstart = -1;
+        *rend = -1;
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * The cursor position is not a part of key: MOD_CURSOR has no effect on the look of line.
+ * The key must be zeroed to compare it with memcmp().
+ */
+
+static void
+render_key_init (WEdit * edit, long b, long eol, long start_col, long end_col, long m1, long m2,
+                 int book_mark, render_key_t * key)
+{
+    memset (key, 0, sizeof (*key));
+
+    key->start_col = start_col;
+    key->end_col = end_col;
+    key->edit_start_col = edit->start_col;
+
+    render_clip (m1, m2, b, eol, &key->mark_start, &key->mark_end);
+    if (edit->column_highlight && key->mark_start >= 0)
+    {
+        key->column1 = edit->column1;
+        key->column2 = edit->column2;
+    }
+    render_clip (edit->found_start, edit->found_start + edit->found_len, b, eol,
+                 &key->found_start, &key->found_end);
+    key->bracket = (edit->bracket >= b && edit->bracket <= eol) ? edit->bracket - b : -1;
+    key->book_mark = book_mark;
+
+    key->highlight = tty_use_colors () && edit->rules != NULL && option_syntax_highlighting;
+    /* edit_get_syntax_color (edit, b - 1) has been just called */
+    if (key->highlight)
+        key->rule = edit->rule;
+
+    key->tab_size = TAB_SIZE;
+    key->show_tabs = visible_tabs && enable_show_tabs_tws;
+    key->show_tws = visible_tws && enable_show_tabs_tws;
+    key->utf8 = edit->utf8;
+    key->utf8_display = mc_global.utf8_display;
+    key->converter = edit->converter;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static render_line_t *
+render_cache_find (WEdit * edit, long b)
+{
+    struct _render_cache *rc = edit->render_cache;
+    int i;
+
+    if (rc == NULL)
+        return NULL;
+
+    for (i = 0; i < rc->num; i++)
+        if (rc->lines[i].b == b)
+            return &rc->lines[i];
+
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+render_cache_drop (struct _render_cache *rc)
+{
+    int i;
+
+    for (i = 0; i < rc->num; i++)
+        rc->lines[i].b = -1;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Remember rendered line. If entry is NULL, the least recently used one is reused.
+ */
+
+static void
+render_cache_store (WEdit * edit, render_line_t * entry, long b, long eol,
+                    const render_key_t * key, long start_col, long start_col_real,
+                    const struct line_s *line, size_t len)
+{
+    struct _render_cache *rc = edit->render_cache;
+
+    if (rc == NULL)
+    {
+        rc = g_new0 (struct _render_cache, 1);
+        edit->render_cache = rc;
+    }
+
+    if (entry == NULL)
+    {
+        int i;
+
+        for (i = 0; i < rc->num; i++)
+            if (entry == NULL || rc->lines[i].b == -1
+                || (entry->b != -1 && rc->lines[i].frame < entry->frame))
+                entry = &rc->lines[i];
+
+        /* all lines are on the screen: room for more lines is required */
+        if (entry == NULL || (entry->b != -1 && entry->frame == rc->frame))
+        {
+            int num;
+
+            num = max (rc->num * 2, edit->widget.lines);
+            rc->lines = g_renew (render_line_t, rc->lines, num);
+            memset (rc->lines + rc->num, 0, (num - rc->num) * sizeof (render_line_t));
+            for (i = rc->num; i < num; i++)
+                rc->lines[i].b = -1;
+            entry = &rc->lines[rc->num];
+            rc->num = num;
+        }
+    }
+
+    if (entry->size < len)
+    {
+        entry->cells = g_renew (struct line_s, entry->cells, len);
+        entry->size = len;
+    }
+    memcpy (entry->cells, line, len * sizeof (struct line_s));
+
+    entry->b = b;
+    entry->eol = eol;
+    entry->frame = rc->frame;
+    memcpy (&entry->key, key, sizeof (entry->key));
+    entry->start_col = start_col;
+    entry->start_col_real = start_col_real;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 /** b is a pointer to the beginning of the line */
 
@@ -340,6 +533,10 @@ edit_draw_this_line (WEdit * edit, long b, long row, long start_col, long end_co
     unsigned int cur_line = 0;
     int book_mark = 0;
     char line_stat[LINE_STATE_WIDTH + 1] = "\0";
+    gboolean in_text;
+    long eol = 0;
+    render_key_t key;
+    render_line_t *cached = NULL;
 
     if (row > edit->widget.lines - 1 - EDIT_TEXT_VERTICAL_OFFSET)
         return;
@@ -357,8 +554,6 @@ edit_draw_this_line (WEdit * edit, long b, long row, long start_col, long end_co
     end_col -= EDIT_TEXT_HORIZONTAL_OFFSET + option_line_state_width;
 
     edit_get_syntax_color (edit, b - 1, &color);
-    q = edit_move_forward3 (edit, b, start_col - edit->start_col, 0);
-    start_col_real = (col = (int) edit_move_forward3 (edit, b, 0, q)) + edit->start_col;
     if (option_line_state)
     {
         cur_line = edit->start_line + row;
@@ -377,16 +572,36 @@ edit_draw_this_line (WEdit * edit, long b, long row, long start_col, long end_co
         }
     }
 
-    if (col + 16 > -edit->start_col)
+    /* rows after the end of text have no line to be cached */
+    in_text = (row <= edit->total_lines - edit->start_line);
+    if (in_text)
     {
         eval_marks (edit, &m1, &m2);
 
-        if (row <= edit->total_lines - edit->start_line)
+        cached = render_cache_find (edit, b);
+        eol = (cached != NULL) ? cached->eol : edit_eol (edit, b);
+        render_key_init (edit, b, eol, start_col, end_col, m1, m2, book_mark, &key);
+
+        if (cached != NULL && memcmp (&key, &cached->key, sizeof (key)) == 0)
+        {
+            cached->frame = edit->render_cache->frame;
+            print_to_widget (edit, row, cached->start_col, cached->start_col_real, end_col,
+                             cached->cells, line_stat, book_mark);
+            return;
+        }
+    }
+
+    q = edit_move_forward3 (edit, b, start_col - edit->start_col, 0);
+    start_col_real = (col = (int) edit_move_forward3 (edit, b, 0, q)) + edit->start_col;
+
+    if (col + 16 > -edit->start_col)
+    {
+        if (in_text)
         {
             long tws = 0;
             if (tty_use_colors () && visible_tws)
             {
-                tws = edit_eol (edit, b);
+                tws = eol;
                 while (tws > b && ((c = edit_get_byte (edit, tws - 1)) == ' ' || c == '\t'))
                     tws--;
             }
@@ -606,6 +821,10 @@ edit_draw_this_line (WEdit * edit, long b, long row, long start_col, long end_co
 
     p->ch = '\0';
 
+    if (in_text)
+        render_cache_store (edit, cached, b, eol, &key, start_col, start_col_real, line,
+                            p - line + 1);
+
     print_to_widget (edit, row, start_col, start_col_real, end_col, line, line_stat, book_mark);
 }
 
@@ -638,6 +857,12 @@ render_edit_text (WEdit * edit, long start_row, long start_column, long end_row,
     int last_line;
     int last_column;
 
+    if (edit->render_cache != NULL)
+    {
+        edit->render_cache->frame++;
+        edit->render_cache->changes = 0;
+    }
+
     /* draw only visible region */
 
     last_line = h->y + h->lines - 1;
@@ -935,3 +1160,63 @@ edit_render_keypress (WEdit * edit)
 }
 
 /* --------------------------------------------------------------------------------------------- */
+/**
+ * Update the rendered lines after change of buffer.
+ *
+ * @param offset position of change
+ * @param delta number of inserted bytes if positive, number of deleted ones if negative
+ */
+
+void
+edit_render_cache_changed (WEdit * edit, long offset, long delta)
+{
+    struct _render_cache *rc = edit->render_cache;
+    int i;
+
+    if (rc == NULL || rc->changes > RENDER_CACHE_MAX_CHANGES)
+        return;
+
+    /* bulk change: don't track every byte of it */
+    if (++rc->changes > RENDER_CACHE_MAX_CHANGES)
+    {
+        render_cache_drop (rc);
+        return;
+    }
+
+    for (i = 0; i < rc->num; i++)
+    {
+        render_line_t *l = &rc->lines[i];
+
+        if (l->b == -1 || offset > l->eol)
+            continue;
+
+        /* text of lines after the change is the same, just moved */
+        if (delta > 0 ? l->b > offset : l->b >= offset - delta)
+        {
+            l->b += delta;
+            l->eol += delta;
+        }
+        else
+            l->b = -1;
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+void
+edit_render_cache_free (WEdit * edit)
+{
+    struct _render_cache *rc = edit->render_cache;
+    int i;
+
+    if (rc == NULL)
+        return;
+
+    for (i = 0; i < rc->num; i++)
+        g_free (rc->lines[i].cells);
+    g_free (rc->lines);
+    g_free (rc);
+    edit->render_cache = NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
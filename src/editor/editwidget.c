@@ -411,6 +411,38 @@ edit_file (const char *_file, int line)
 
 /* --------------------------------------------------------------------------------------------- */
 
+static void
+edit_collect_editors_cb (void *data, void *user_data)
+{
+    WEdit *edit;
+
+    edit = (WEdit *) find_widget_type ((const Dlg_head *) data, edit_callback);
+    if (edit != NULL)
+    {
+        GList **editors = (GList **) user_data;
+
+        *editors = g_list_prepend (*editors, edit);
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Get editors of all open edit screens.
+ *
+ * @return list of WEdit objects. List must be freed with g_list_free()
+ */
+
+GList *
+edit_get_all_editors (void)
+{
+    GList *editors = NULL;
+
+    dialog_switch_foreach (edit_collect_editors_cb, &editors);
+    return g_list_reverse (editors);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
 const char *
 edit_get_file_name (const WEdit * edit)
 {
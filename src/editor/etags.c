@@ -36,9 +36,17 @@
 #include <inttypes.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
 
 #include "lib/global.h"
 #include "lib/util.h"           /* canonicalize_pathname() */
+#include "lib/mcconfig.h"       /* mc_config_get_cache_path() */
 
 #include "etags.h"
 
@@ -46,130 +54,235 @@
 
 /*** file scope macro definitions ****************************************************************/
 
+/* The index is stored next to the TAGS file */
+#define ETAGS_INDEX_SUFFIX ".mcidx"
+/* or in the cache directory, if directory of TAGS file is not writable */
+#define ETAGS_INDEX_CACHE_PREFIX "TAGS-"
+
+#define ETAGS_INDEX_MAGIC "MCETIDX1"
+#define ETAGS_INDEX_BYTE_ORDER 0x01020304
+
 /*** file scope type declarations ****************************************************************/
 
+/*
+ * Index file layout (native byte order):
+ *   header
+ *   guint32 files[num_files]               - offsets of file names in the string pool
+ *   etags_index_entry_t entries[num_entries] - sorted by symbol name
+ *   char pool[pool_len]                    - NUL-terminated strings
+ */
+
+typedef struct
+{
+    char magic[8];
+    guint32 byte_order;
+    guint32 num_entries;
+    guint32 num_files;
+    guint32 pool_len;
+    gint64 tags_mtime;          /* stat of the TAGS file the index was built from */
+    gint64 tags_size;
+} etags_index_header_t;
+
+typedef struct
+{
+    guint32 name;               /* offset of symbol name in the string pool */
+    guint32 file;               /* number of file in the file table */
+    guint32 line;
+} etags_index_entry_t;
+
+typedef struct
+{
+    char *data;
+    size_t len;
+    gboolean mapped;            /* data is mmap()ed, otherwise g_malloc()ed */
+
+    const etags_index_header_t *header;
+    const guint32 *files;
+    const etags_index_entry_t *entries;
+    const char *pool;
+} etags_index_t;
+
 /*** file scope variables ************************************************************************/
 
 /*** file scope functions ************************************************************************/
 /* --------------------------------------------------------------------------------------------- */
 
 static gboolean
-parse_define (char *buf, char **long_name, char **short_name, long *line)
+etags_is_ident_char (char c)
 {
-    /* *INDENT-OFF* */
-    enum
-    {
-        in_longname,
-        in_shortname,
-        in_shortname_first_char,
-        in_line, finish
-    } def_state = in_longname;
-    /* *INDENT-ON* */
+    return (isalnum ((unsigned char) c) || c == '_' || c == '$' || (unsigned char) c >= 0x80);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Parse definition line of TAGS file:
+ *   pattern 0x7F [name 0x01] line,offset
+ * If explicit name is absent, it is taken from the pattern.
+ *
+ * @return TRUE if name of symbol is found
+ */
+
+static gboolean
+parse_define (const char *buf, const char **name, size_t * name_len, long *line)
+{
+    const char *del, *p;
 
-    static char longdef[LONG_DEF_LEN];
-    static char shortdef[SHORT_DEF_LEN];
-    static char linedef[LINE_DEF_LEN];
-    int nlong = 0;
-    int nshort = 0;
-    int nline = 0;
-    char c = *buf;
+    del = strchr (buf, 0x7F);
+    if (del == NULL)
+        return FALSE;
 
-    while (!(c == '\0' || c == '\n'))
+    p = strchr (del + 1, 0x01);
+    if (p != NULL)
+    {
+        /* explicit name */
+        *name = del + 1;
+        *name_len = (size_t) (p - del - 1);
+        p++;
+    }
+    else
     {
-        switch (def_state)
+        /* implicit name: last identifier before the argument list or the delimiter */
+        p = memchr (buf, '(', (size_t) (del - buf));
+        if (p == NULL)
+            p = del;
+        while (p > buf && !etags_is_ident_char (p[-1]))
+            p--;
+        *name_len = 0;
+        while (p > buf && etags_is_ident_char (p[-1]))
         {
-        case in_longname:
-            if (c == 0x01)
-            {
-                def_state = in_line;
-            }
-            else if (c == 0x7F)
-            {
-                def_state = in_shortname;
-            }
-            else
-            {
-                if (nlong < LONG_DEF_LEN - 1)
-                {
-                    longdef[nlong++] = c;
-                }
-            }
-            break;
-        case in_shortname_first_char:
-            if (isdigit (c))
-            {
-                nshort = 0;
-                buf--;
-                def_state = in_line;
-            }
-            else if (c == 0x01)
-            {
-                def_state = in_line;
-            }
-            else
-            {
-                if (nshort < SHORT_DEF_LEN - 1)
-                {
-                    shortdef[nshort++] = c;
-                    def_state = in_shortname;
-                }
-            }
-            break;
-        case in_shortname:
-            if (c == 0x01)
-            {
-                def_state = in_line;
-            }
-            else if (c == '\n')
-            {
-                def_state = finish;
-            }
-            else
-            {
-                if (nshort < SHORT_DEF_LEN - 1)
-                {
-                    shortdef[nshort++] = c;
-                }
-            }
-            break;
-        case in_line:
-            if (c == ',' || c == '\n')
-            {
-                def_state = finish;
-            }
-            else if (isdigit (c))
-            {
-                if (nline < LINE_DEF_LEN - 1)
-                {
-                    linedef[nline++] = c;
-                }
-            }
-            break;
-        case finish:
-            longdef[nlong] = '\0';
-            shortdef[nshort] = '\0';
-            linedef[nline] = '\0';
-            *long_name = longdef;
-            *short_name = shortdef;
-            *line = atol (linedef);
-            return TRUE;
+            p--;
+            (*name_len)++;
         }
-        buf++;
-        c = *buf;
+        *name = p;
+        p = del + 1;
     }
-    *long_name = NULL;
-    *short_name = NULL;
-    *line = 0;
-    return FALSE;
+
+    *line = atol (p);
+    return (*name_len != 0);
 }
 
 /* --------------------------------------------------------------------------------------------- */
-/*** public functions ****************************************************************************/
+
+static int
+etags_index_entry_cmp (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+    const char *pool = (const char *) user_data;
+    const etags_index_entry_t *ea = (const etags_index_entry_t *) a;
+    const etags_index_entry_t *eb = (const etags_index_entry_t *) b;
+    int ret;
+
+    ret = strcmp (pool + ea->name, pool + eb->name);
+    if (ret == 0)
+        ret = (ea->file != eb->file) ? (ea->file < eb->file ? -1 : 1) : (int) ea->line - (int) eb->line;
+    return ret;
+}
+
 /* --------------------------------------------------------------------------------------------- */
+/**
+ * Check the index data and set pointers to its tables.
+ */
 
-int
-etags_set_definition_hash (const char *tagfile, const char *start_path,
-                           const char *match_func, etags_hash_t * def_hash)
+static gboolean
+etags_index_setup (etags_index_t * idx, const struct stat *tags_st)
+{
+    const etags_index_header_t *h;
+    guint64 need;
+
+    if (idx->len < sizeof (etags_index_header_t))
+        return FALSE;
+
+    h = (const etags_index_header_t *) idx->data;
+    if (memcmp (h->magic, ETAGS_INDEX_MAGIC, sizeof (h->magic)) != 0
+        || h->byte_order != ETAGS_INDEX_BYTE_ORDER
+        || h->tags_mtime != (gint64) tags_st->st_mtime || h->tags_size != (gint64) tags_st->st_size)
+        return FALSE;
+
+    need = sizeof (etags_index_header_t) + (guint64) h->num_files * sizeof (guint32)
+        + (guint64) h->num_entries * sizeof (etags_index_entry_t) + h->pool_len;
+    if (need != idx->len || h->pool_len == 0 || idx->data[idx->len - 1] != '\0')
+        return FALSE;
+
+    idx->header = h;
+    idx->files = (const guint32 *) (idx->data + sizeof (etags_index_header_t));
+    idx->entries = (const etags_index_entry_t *) (idx->files + h->num_files);
+    idx->pool = (const char *) (idx->entries + h->num_entries);
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+etags_index_close (etags_index_t * idx)
+{
+    if (idx->data == NULL)
+        return;
+
+#ifdef HAVE_MMAP
+    if (idx->mapped)
+        munmap (idx->data, idx->len);
+    else
+#endif
+        g_free (idx->data);
+
+    idx->data = NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Load existing index file.
+ */
+
+static gboolean
+etags_index_load (const char *index_file, const struct stat *tags_st, etags_index_t * idx)
+{
+#ifdef HAVE_MMAP
+    int fd;
+    struct stat st;
+
+    fd = open (index_file, O_RDONLY);
+    if (fd == -1)
+        return FALSE;
+
+    if (fstat (fd, &st) == 0 && st.st_size > 0)
+    {
+        idx->len = (size_t) st.st_size;
+        idx->data = mmap (NULL, idx->len, PROT_READ, MAP_FILE | MAP_PRIVATE, fd, 0);
+        if (idx->data == (char *) MAP_FAILED)
+            idx->data = NULL;
+        else
+            idx->mapped = TRUE;
+    }
+    close (fd);
+#else
+    gsize len;
+
+    if (g_file_get_contents (index_file, &idx->data, &len, NULL))
+        idx->len = len;
+    else
+        idx->data = NULL;
+#endif
+
+    if (idx->data == NULL)
+        return FALSE;
+
+    if (!etags_index_setup (idx, tags_st))
+    {
+        etags_index_close (idx);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Parse TAGS file and create index of it. Try to save index next to TAGS file,
+ * then to the cache directory.
+ */
+
+static gboolean
+etags_index_create (const char *tagfile, const char *index_file, const char *cache_file,
+                    const struct stat *tags_st, etags_index_t * idx)
 {
     /* *INDENT-OFF* */
     enum
@@ -181,81 +294,267 @@ etags_set_definition_hash (const char *tagfile, const char *start_path,
     /* *INDENT-ON* */
 
     FILE *f;
-    static char buf[BUF_LARGE];
-
-    char *chekedstr = NULL;
-
-    int num = 0;                /* returned value */
-    int pos;
-    char *filename = NULL;
-
-    if (!match_func || !tagfile)
-        return 0;
+    char buf[BUF_8K];
+    gboolean continuation = FALSE;
+    GString *pool;
+    GArray *files, *entries;
+    etags_index_header_t header;
+    gboolean ret = FALSE;
 
-    /* open file with positions */
     f = fopen (tagfile, "r");
     if (f == NULL)
-        return 0;
+        return FALSE;
+
+    pool = g_string_sized_new (BUF_8K);
+    files = g_array_new (FALSE, FALSE, sizeof (guint32));
+    entries = g_array_new (FALSE, FALSE, sizeof (etags_index_entry_t));
 
-    while (fgets (buf, sizeof (buf), f))
+    while (fgets (buf, sizeof (buf), f) != NULL)
     {
+        gboolean part = continuation;
+
+        /* tail of too long line */
+        continuation = (strchr (buf, '\n') == NULL && !feof (f));
+        if (part)
+            continue;
+
+        if (buf[0] == 0x0C)
+        {
+            state = in_filename;
+            continue;
+        }
+
         switch (state)
         {
         case start:
-            if (buf[0] == 0x0C)
-            {
-                state = in_filename;
-            }
             break;
         case in_filename:
-            pos = strcspn (buf, ",");
-            g_free (filename);
-            filename = g_malloc (pos + 2);
-            g_strlcpy (filename, (char *) buf, pos + 1);
-            state = in_define;
-            break;
-        case in_define:
-            if (buf[0] == 0x0C)
             {
-                state = in_filename;
-                break;
+                guint32 offset = pool->len;
+
+                g_string_append_len (pool, buf, strcspn (buf, ",\n"));
+                g_string_append_c (pool, '\0');
+                g_array_append_val (files, offset);
+                state = in_define;
             }
-            /* check if the filename matches the define pos */
-            chekedstr = strstr (buf, match_func);
-            if (chekedstr)
+            break;
+        case in_define:
             {
-                char *longname = NULL;
-                char *shortname = NULL;
-                long line = 0;
-
-                parse_define (chekedstr, &longname, &shortname, &line);
-                if (num < MAX_DEFINITIONS - 1)
-                {
-                    def_hash[num].filename_len = strlen (filename);
-                    def_hash[num].fullpath =
-                        mc_build_filename (start_path, filename, (char *) NULL);
-
-                    canonicalize_pathname (def_hash[num].fullpath);
-                    def_hash[num].filename = g_strdup (filename);
-                    if (shortname)
-                    {
-                        def_hash[num].short_define = g_strdup (shortname);
-                    }
-                    else
-                    {
-                        def_hash[num].short_define = g_strdup (longname);
-                    }
-                    def_hash[num].line = line;
-                    num++;
-                }
+                const char *name;
+                size_t name_len;
+                long line;
+                etags_index_entry_t e;
+
+                if (continuation || !parse_define (buf, &name, &name_len, &line))
+                    break;
+
+                e.name = pool->len;
+                e.file = files->len - 1;
+                e.line = (guint32) line;
+                g_string_append_len (pool, name, name_len);
+                g_string_append_c (pool, '\0');
+                g_array_append_val (entries, e);
             }
             break;
         }
+
+        /* offsets are 32-bit */
+        if (pool->len >= G_MAXINT32)
+            goto done;
     }
 
-    g_free (filename);
+    if (pool->len == 0)
+        g_string_append_c (pool, '\0');
+
+    g_qsort_with_data (entries->data, entries->len, sizeof (etags_index_entry_t),
+                       etags_index_entry_cmp, pool->str);
+
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, ETAGS_INDEX_MAGIC, sizeof (header.magic));
+    header.byte_order = ETAGS_INDEX_BYTE_ORDER;
+    header.num_entries = entries->len;
+    header.num_files = files->len;
+    header.pool_len = pool->len;
+    header.tags_mtime = (gint64) tags_st->st_mtime;
+    header.tags_size = (gint64) tags_st->st_size;
+
+    idx->len = sizeof (header) + files->len * sizeof (guint32)
+        + entries->len * sizeof (etags_index_entry_t) + pool->len;
+    idx->data = g_malloc (idx->len);
+    idx->mapped = FALSE;
+    {
+        char *p = idx->data;
+
+        memcpy (p, &header, sizeof (header));
+        p += sizeof (header);
+        memcpy (p, files->data, files->len * sizeof (guint32));
+        p += files->len * sizeof (guint32);
+        memcpy (p, entries->data, entries->len * sizeof (etags_index_entry_t));
+        p += entries->len * sizeof (etags_index_entry_t);
+        memcpy (p, pool->str, pool->len);
+    }
+
+    ret = etags_index_setup (idx, tags_st);
+    if (ret)
+    {
+        /* index is usable even if it cannot be saved */
+        if (!g_file_set_contents (index_file, idx->data, idx->len, NULL))
+            (void) g_file_set_contents (cache_file, idx->data, idx->len, NULL);
+    }
+    else
+        etags_index_close (idx);
+
+  done:
+    g_array_free (entries, TRUE);
+    g_array_free (files, TRUE);
+    g_string_free (pool, TRUE);
     fclose (f);
+    return ret;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Open index of TAGS file. The index is rebuilt if TAGS file was changed.
+ */
+
+static gboolean
+etags_index_open (const char *tagfile, etags_index_t * idx)
+{
+    struct stat st;
+    char *index_file, *cache_file, *name;
+    gboolean ret;
+
+    memset (idx, 0, sizeof (etags_index_t));
+
+    if (stat (tagfile, &st) != 0)
+        return FALSE;
+
+    index_file = g_strconcat (tagfile, ETAGS_INDEX_SUFFIX, (char *) NULL);
+    /* index in the cache is found by hash of TAGS file name; header checks mtime and size */
+    name = g_strdup_printf (ETAGS_INDEX_CACHE_PREFIX "%08x" ETAGS_INDEX_SUFFIX,
+                            g_str_hash (tagfile));
+    cache_file = g_build_filename (mc_config_get_cache_path (), name, (char *) NULL);
+    g_free (name);
+
+    ret = etags_index_load (index_file, &st, idx)
+        || etags_index_load (cache_file, &st, idx)
+        || etags_index_create (tagfile, index_file, cache_file, &st, idx);
+    g_free (cache_file);
+    g_free (index_file);
+
+    return ret;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/** Number of the first entry which name is not less than prefix */
+
+static guint32
+etags_index_lower_bound (const etags_index_t * idx, const char *prefix, size_t prefix_len)
+{
+    guint32 lo = 0, hi = idx->header->num_entries;
+
+    while (lo < hi)
+    {
+        guint32 mid;
+
+        mid = lo + (hi - lo) / 2;
+        if (strncmp (idx->pool + idx->entries[mid].name, prefix, prefix_len) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/*** public functions ****************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Find definitions of symbols started with match_func.
+ *
+ * @return number of found definitions
+ */
+
+int
+etags_set_definition_hash (const char *tagfile, const char *start_path,
+                           const char *match_func, etags_hash_t * def_hash)
+{
+    etags_index_t idx;
+    size_t len;
+    guint32 i;
+    int num = 0;                /* returned value */
+
+    if (!match_func || !tagfile)
+        return 0;
+
+    if (!etags_index_open (tagfile, &idx))
+        return 0;
+
+    len = strlen (match_func);
+
+    for (i = etags_index_lower_bound (&idx, match_func, len);
+         i < idx.header->num_entries && num < MAX_DEFINITIONS - 1; i++)
+    {
+        const etags_index_entry_t *e = &idx.entries[i];
+        const char *name, *filename;
+
+        name = idx.pool + e->name;
+        if (strncmp (name, match_func, len) != 0)
+            break;
+
+        filename = idx.pool + idx.files[e->file];
+        def_hash[num].filename_len = strlen (filename);
+        def_hash[num].fullpath = mc_build_filename (start_path, filename, (char *) NULL);
+        canonicalize_pathname (def_hash[num].fullpath);
+        def_hash[num].filename = g_strdup (filename);
+        def_hash[num].short_define = g_strdup (name);
+        def_hash[num].line = e->line;
+        num++;
+    }
+
+    etags_index_close (&idx);
     return num;
 }
 
 /* --------------------------------------------------------------------------------------------- */
+/**
+ * Get names of symbols which start with prefix and are longer than it.
+ *
+ * @return array of newly allocated names in alphabetical order, NULL if TAGS file is unusable.
+ *         Array must be freed with g_ptr_array_free (array, TRUE) after freeing its items.
+ */
+
+GPtrArray *
+etags_get_symbols (const char *tagfile, const char *prefix, size_t prefix_len, guint max)
+{
+    etags_index_t idx;
+    GPtrArray *ret;
+    const char *prev = NULL;
+    guint32 i;
+
+    if (tagfile == NULL || !etags_index_open (tagfile, &idx))
+        return NULL;
+
+    ret = g_ptr_array_new ();
+
+    for (i = etags_index_lower_bound (&idx, prefix, prefix_len);
+         i < idx.header->num_entries && ret->len < max; i++)
+    {
+        const char *name;
+
+        name = idx.pool + idx.entries[i].name;
+        if (strncmp (name, prefix, prefix_len) != 0)
+            break;
+
+        /* entries are sorted, so duplicates are adjacent */
+        if (name[prefix_len] != '\0' && (prev == NULL || strcmp (prev, name) != 0))
+            g_ptr_array_add (ret, g_strdup (name));
+        prev = name;
+    }
+
+    etags_index_close (&idx);
+    return ret;
+}
+
+/* --------------------------------------------------------------------------------------------- */
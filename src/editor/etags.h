@@ -32,6 +32,8 @@ typedef struct etags_hash_struct
 
 int etags_set_definition_hash (const char *tagfile, const char *start_path,
                                const char *match_func, etags_hash_t * def_hash);
+GPtrArray *etags_get_symbols (const char *tagfile, const char *prefix, size_t prefix_len,
+                              guint max);
 
 /*** inline functions ****************************************************************************/
 #endif /* MC__EDIT_ETAGS_H */
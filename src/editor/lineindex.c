@@ -0,0 +1,248 @@
+/*
+   Editor index of line starts
+
+   Copyright (C) 2011
+   The Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** \file
+ *  \brief Source: editor index of line starts
+ *
+ *  Both parts of the buffer (before and after cursor) are split into blocks
+ *  of LINE_INDEX_BLOCK bytes, the number of newlines in blocks is kept in
+ *  Fenwick trees.  Blocks are counted from the cursor for the text before it
+ *  and from the end of file for the text after it, like bytes in buffers1 and
+ *  buffers2, so insertion or deletion at cursor and cursor movement change
+ *  one block only.  Line number of offset and offset of line are found in
+ *  O(log n) plus a scan of one block.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include "lib/global.h"
+
+#include "edit-impl.h"
+#include "edit-widget.h"
+
+/*** global variables ****************************************************************************/
+
+/*** file scope macro definitions ****************************************************************/
+
+#define LINE_INDEX_BLOCK_SHIFT 12
+#define LINE_INDEX_BLOCK (1L << LINE_INDEX_BLOCK_SHIFT)
+
+/*** file scope type declarations ****************************************************************/
+
+typedef struct
+{
+    long *tree;                 /* Fenwick tree of newline numbers in blocks, 1-based */
+    long size;                  /* number of blocks, power of 2 */
+    long total;                 /* number of newlines */
+} line_index_part_t;
+
+struct _line_index
+{
+    line_index_part_t part[2];  /* text before cursor (buffers1) and after it (buffers2) */
+};
+
+/*** file scope variables ************************************************************************/
+
+/*** file scope functions ************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+
+static inline int
+line_index_get_byte (WEdit * edit, int part, long pos)
+{
+    return edit_get_byte (edit, part == 0 ? pos : edit->curs1 + edit->curs2 - 1 - pos);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+line_index_grow (line_index_part_t * li)
+{
+    long size;
+
+    size = li->size == 0 ? 1 : li->size * 2;
+    li->tree = g_renew (long, li->tree, size + 1);
+    memset (li->tree + li->size + 1, 0, (size - li->size) * sizeof (long));
+    /* new blocks are empty, so only the node covering all blocks is not zero */
+    li->tree[size] = li->total;
+    li->size = size;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+line_index_add (line_index_part_t * li, long block, long delta)
+{
+    long i;
+
+    while (block >= li->size)
+        line_index_grow (li);
+
+    for (i = block + 1; i <= li->size; i += i & (-i))
+        li->tree[i] += delta;
+    li->total += delta;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/** Number of newlines in positions [0, pos) of the part */
+
+static long
+line_index_count_below (WEdit * edit, int part, long pos)
+{
+    line_index_part_t *li = &edit->line_index->part[part];
+    long block, i, n = 0;
+
+    block = pos >> LINE_INDEX_BLOCK_SHIFT;
+
+    for (i = min (block, li->size); i > 0; i -= i & (-i))
+        n += li->tree[i];
+
+    for (i = block << LINE_INDEX_BLOCK_SHIFT; i < pos; i++)
+        if (line_index_get_byte (edit, part, i) == '\n')
+            n++;
+
+    return n;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/** Position of k-th (1-based) newline of the part */
+
+static long
+line_index_find_newline (WEdit * edit, int part, long k)
+{
+    line_index_part_t *li = &edit->line_index->part[part];
+    long block = 0, step, pos;
+
+    /* find the block that contains k-th newline */
+    for (step = li->size; step > 0; step >>= 1)
+        if (block + step <= li->size && li->tree[block + step] < k)
+        {
+            block += step;
+            k -= li->tree[block];
+        }
+
+    for (pos = block << LINE_INDEX_BLOCK_SHIFT;; pos++)
+        if (line_index_get_byte (edit, part, pos) == '\n' && --k == 0)
+            break;
+
+    return pos;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+line_index_build (WEdit * edit)
+{
+    long i;
+
+    if (edit->line_index != NULL)
+        return;
+
+    edit->line_index = g_new0 (struct _line_index, 1);
+
+    for (i = 0; i < edit->curs1; i++)
+        if (line_index_get_byte (edit, 0, i) == '\n')
+            line_index_add (&edit->line_index->part[0], i >> LINE_INDEX_BLOCK_SHIFT, 1);
+
+    for (i = 0; i < edit->curs2; i++)
+        if (line_index_get_byte (edit, 1, i) == '\n')
+            line_index_add (&edit->line_index->part[1], i >> LINE_INDEX_BLOCK_SHIFT, 1);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/*** public functions ****************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+
+void
+edit_line_index_free (WEdit * edit)
+{
+    if (edit->line_index == NULL)
+        return;
+
+    g_free (edit->line_index->part[0].tree);
+    g_free (edit->line_index->part[1].tree);
+    g_free (edit->line_index);
+    edit->line_index = NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Account newline stored to (delta = 1) or removed from (delta = -1) the buffer.
+ *
+ * @param after_cursor TRUE if newline is in buffers2
+ * @param pos position of newline in buffers1 (offset) or in buffers2 (distance from the end)
+ */
+
+void
+edit_line_index_update (WEdit * edit, gboolean after_cursor, long pos, int delta)
+{
+    if (edit->line_index != NULL)
+        line_index_add (&edit->line_index->part[after_cursor ? 1 : 0],
+                        pos >> LINE_INDEX_BLOCK_SHIFT, delta);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Get number of line that contains offset, i.e. the number of newlines before it.
+ */
+
+long
+edit_line_index_count (WEdit * edit, long offset)
+{
+    line_index_build (edit);
+
+    if (offset <= edit->curs1)
+        return line_index_count_below (edit, 0, offset);
+
+    /* offsets [curs1, offset) are positions [curs1 + curs2 - offset, curs2) of buffers2 */
+    return edit->line_index->part[0].total + edit->line_index->part[1].total
+        - line_index_count_below (edit, 1, edit->curs1 + edit->curs2 - offset);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Get offset of beginning of line. Beginning of the last line is returned for too big line.
+ */
+
+long
+edit_line_index_find (WEdit * edit, long line)
+{
+    line_index_part_t *li;
+
+    line_index_build (edit);
+    li = edit->line_index->part;
+
+    if (line > li[0].total + li[1].total)
+        line = li[0].total + li[1].total;
+    if (line <= 0)
+        return 0;
+
+    if (line <= li[0].total)
+        return line_index_find_newline (edit, 0, line) + 1;
+
+    /* buffers2 is stored backward: count newlines from the end of file */
+    line = li[1].total - (line - li[0].total) + 1;
+    return edit->curs1 + edit->curs2 - line_index_find_newline (edit, 1, line);
+}
+
+/* --------------------------------------------------------------------------------------------- */
@@ -548,6 +548,19 @@ apply_rules_going_right (WEdit * edit, long i, struct syntax_rule rule)
 
 /* --------------------------------------------------------------------------------------------- */
 
+static void
+edit_free_syntax_markers (WEdit * edit)
+{
+    while (edit->syntax_marker)
+    {
+        struct _syntax_marker *s = edit->syntax_marker->next;
+        g_free (edit->syntax_marker);
+        edit->syntax_marker = s;
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
 static struct syntax_rule
 edit_get_rule (WEdit * edit, long byte_index)
 {
@@ -1425,6 +1438,19 @@ edit_get_syntax_color (WEdit * edit, long byte_index, int *color)
         *color = EDITOR_NORMAL_COLOR;
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Forget the syntax state of the whole text, e.g. after the text is replaced.
+ */
+
+void
+edit_syntax_forget (WEdit * edit)
+{
+    edit_free_syntax_markers (edit);
+    /* next edit_get_rule() goes back to the beginning of the text */
+    edit->last_get_rule = G_MAXLONG;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 
 void
@@ -1434,6 +1460,8 @@ edit_free_syntax_rules (WEdit * edit)
 
     if (!edit)
         return;
+    /* colors of rendered lines belong to the old rules */
+    edit_render_cache_free (edit);
     if (edit->defines)
         destroy_defines (&edit->defines);
     if (!edit->rules)
@@ -1463,12 +1491,7 @@ edit_free_syntax_rules (WEdit * edit)
         MC_PTR_FREE (edit->rules[i]);
     }
 
-    while (edit->syntax_marker)
-    {
-        struct _syntax_marker *s = edit->syntax_marker->next;
-        g_free (edit->syntax_marker);
-        edit->syntax_marker = s;
-    }
+    edit_free_syntax_markers (edit);
 
     MC_PTR_FREE (edit->rules);
     tty_color_free_all_tmp ();
@@ -0,0 +1,301 @@
+/*
+   Editor identifier index for word completion
+
+   Copyright (C) 2011
+   The Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** \file
+ *  \brief Source: editor identifier index for word completion
+ *
+ *  The index keeps every word of the buffer together with the number of its
+ *  occurrences.  It is built on the first completion request and then kept
+ *  up to date by the low level insert/delete routines: before a byte is
+ *  changed the words around it are removed from the index, and after the
+ *  change the words around it are added again.
+ */
+
+#include <config.h>
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lib/global.h"
+
+#include "edit-impl.h"
+#include "edit-widget.h"
+
+/*** global variables ****************************************************************************/
+
+/*** file scope macro definitions ****************************************************************/
+
+/* longer words are not indexed */
+#define WORD_INDEX_MAX_LEN 128
+
+/*** file scope type declarations ****************************************************************/
+
+struct _word_index
+{
+    GHashTable *words;          /* word -> number of occurrences */
+    GPtrArray *sorted;          /* words in strcmp() order, NULL if outdated */
+};
+
+/*** file scope variables ************************************************************************/
+
+/*** file scope functions ************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+word_index_is_word_char (int c)
+{
+    return (c != '\0' && !isspace (c) && strchr ("{}[]()<>=|/\\!?~-+`'\",.;:#$%^&*", c) == NULL);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+word_index_change (struct _word_index *wi, const char *word, int delta)
+{
+    gpointer key, value;
+
+    if (g_hash_table_lookup_extended (wi->words, word, &key, &value))
+    {
+        int count;
+
+        count = GPOINTER_TO_INT (value) + delta;
+        if (count > 0)
+        {
+            g_hash_table_insert (wi->words, key, GINT_TO_POINTER (count));
+            return;
+        }
+
+        g_hash_table_remove (wi->words, word);
+    }
+    else if (delta > 0)
+        g_hash_table_insert (wi->words, g_strdup (word), GINT_TO_POINTER (delta));
+    else
+        return;
+
+    /* set of words has been changed */
+    if (wi->sorted != NULL)
+    {
+        g_ptr_array_free (wi->sorted, TRUE);
+        wi->sorted = NULL;
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Add (delta > 0) or remove (delta < 0) all words in range [start, end).
+ * Words cut by the range bounds are accounted completely.
+ */
+
+static void
+word_index_update (WEdit * edit, long start, long end, int delta)
+{
+    char word[WORD_INDEX_MAX_LEN + 1];
+    long n, p;
+    gsize len = 0;
+
+    /* extend range to the word bounds; stop scanning when the word is too long to be indexed */
+    for (n = 0; n <= WORD_INDEX_MAX_LEN && start > 0
+         && word_index_is_word_char (edit_get_byte (edit, start - 1)); n++)
+        start--;
+
+    for (n = 0; n <= WORD_INDEX_MAX_LEN && end < edit->last_byte
+         && word_index_is_word_char (edit_get_byte (edit, end)); n++)
+        end++;
+
+    for (p = start; p <= end; p++)
+    {
+        int c;
+
+        c = (p < end) ? edit_get_byte (edit, p) : '\0';
+
+        if (word_index_is_word_char (c))
+        {
+            if (len < WORD_INDEX_MAX_LEN + 1)
+                word[len] = (char) c;
+            len++;
+            continue;
+        }
+
+        /* end of word: words started with digit and too long words are not indexed */
+        if (len != 0 && len <= WORD_INDEX_MAX_LEN && !isdigit ((unsigned char) word[0]))
+        {
+            word[len] = '\0';
+            word_index_change (edit->word_index, word, delta);
+        }
+        len = 0;
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+word_index_sort_cb (gconstpointer a, gconstpointer b)
+{
+    return strcmp (*(const char *const *) a, *(const char *const *) b);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+word_index_count_sort_cb (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+    GHashTable *words = (GHashTable *) user_data;
+    const char *wa = *(const char *const *) a;
+    const char *wb = *(const char *const *) b;
+    int ca, cb;
+
+    ca = GPOINTER_TO_INT (g_hash_table_lookup (words, wa));
+    cb = GPOINTER_TO_INT (g_hash_table_lookup (words, wb));
+    if (ca != cb)
+        return (ca > cb) ? -1 : 1;
+    return strcmp (wa, wb);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/*** public functions ****************************************************************************/
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Build the index of the whole buffer if it doesn't exist yet.
+ */
+
+void
+edit_word_index_build (WEdit * edit)
+{
+    if (edit->word_index != NULL)
+        return;
+
+    edit->word_index = g_new (struct _word_index, 1);
+    edit->word_index->words = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    edit->word_index->sorted = NULL;
+
+    word_index_update (edit, 0, edit->last_byte, 1);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+void
+edit_word_index_free (WEdit * edit)
+{
+    if (edit->word_index == NULL)
+        return;
+
+    if (edit->word_index->sorted != NULL)
+        g_ptr_array_free (edit->word_index->sorted, TRUE);
+    g_hash_table_destroy (edit->word_index->words);
+    g_free (edit->word_index);
+    edit->word_index = NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Forget words around byte range [start, end) before it is modified.
+ */
+
+void
+edit_word_index_remove (WEdit * edit, long start, long end)
+{
+    if (edit->word_index != NULL)
+        word_index_update (edit, start, end, -1);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Account words around byte range [start, end) after it was modified.
+ */
+
+void
+edit_word_index_add (WEdit * edit, long start, long end)
+{
+    if (edit->word_index != NULL)
+        word_index_update (edit, start, end, 1);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Find words that start with prefix and are longer than it.
+ *
+ * @param edit editor object
+ * @param prefix beginning of word
+ * @param prefix_len length of prefix
+ *
+ * @return array of words sorted by number of occurrences (most frequent first).
+ *         Words are owned by the index and are valid until the next buffer modification.
+ *         Array must be freed with g_ptr_array_free (array, TRUE).
+ */
+
+GPtrArray *
+edit_word_index_lookup (WEdit * edit, const char *prefix, gsize prefix_len)
+{
+    struct _word_index *wi;
+    GPtrArray *ret;
+    guint lo, hi;
+
+    edit_word_index_build (edit);
+    wi = edit->word_index;
+
+    if (wi->sorted == NULL)
+    {
+        GHashTableIter iter;
+        gpointer key;
+
+        wi->sorted = g_ptr_array_sized_new (g_hash_table_size (wi->words));
+        g_hash_table_iter_init (&iter, wi->words);
+        while (g_hash_table_iter_next (&iter, &key, NULL))
+            g_ptr_array_add (wi->sorted, key);
+        g_ptr_array_sort (wi->sorted, word_index_sort_cb);
+    }
+
+    /* lower bound of prefix */
+    lo = 0;
+    hi = wi->sorted->len;
+    while (lo < hi)
+    {
+        guint mid;
+
+        mid = lo + (hi - lo) / 2;
+        if (strncmp ((char *) g_ptr_array_index (wi->sorted, mid), prefix, prefix_len) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    ret = g_ptr_array_new ();
+
+    for (; lo < wi->sorted->len; lo++)
+    {
+        char *word;
+
+        word = (char *) g_ptr_array_index (wi->sorted, lo);
+        if (strncmp (word, prefix, prefix_len) != 0)
+            break;
+        if (word[prefix_len] != '\0')
+            g_ptr_array_add (ret, word);
+    }
+
+    /* most frequent words first */
+    g_ptr_array_sort_with_data (ret, word_index_count_sort_cb, wi->words);
+
+    return ret;
+}
+
+/* --------------------------------------------------------------------------------------------- */
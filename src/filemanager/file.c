@@ -103,6 +103,12 @@ const char *op_names[3] = {
 #define FILEOP_UPDATE_INTERVAL 2
 #define FILEOP_STALLING_INTERVAL 4
 
+/* max number of marked files passed to VFS_SETCTL_PREFETCH at once */
+#define FILEOP_PREFETCH_FILES 32
+
+/* max number of marked files passed to VFS_SETCTL_BATCH_UNLINK at once */
+#define FILEOP_UNLINK_FILES 64
+
 /*** file scope type declarations ****************************************************************/
 
 /* This is a hard link cache */
@@ -869,20 +875,18 @@ move_file_file (FileOpTotalContext * tctx, FileOpContext * ctx, const char *s, c
 
 /* --------------------------------------------------------------------------------------------- */
 /* {{{ Erase routines */
-/** Don't update progress status if progress_count==NULL */
+/**
+ * Delete file shown by the progress dialog already, abort is checked by the caller.
+ * Don't update progress status if progress_count==NULL
+ */
 
 static FileProgressStatus
-erase_file (FileOpTotalContext * tctx, FileOpContext * ctx, const char *s,
-            gboolean is_toplevel_file)
+erase_shown_file (FileOpTotalContext * tctx, FileOpContext * ctx, const char *s,
+                  gboolean is_toplevel_file)
 {
     int return_status;
     struct stat buf;
 
-    file_progress_show_deleting (ctx, s);
-    if (check_progress_buttons (ctx) == FILE_ABORT)
-        return FILE_ABORT;
-    mc_refresh ();
-
     if (tctx->progress_count != 0 && mc_lstat (s, &buf) != 0)
     {
         /* ignore, most likely the mc_unlink fails, too */
@@ -908,6 +912,20 @@ erase_file (FileOpTotalContext * tctx, FileOpContext * ctx, const char *s,
 
 /* --------------------------------------------------------------------------------------------- */
 
+static FileProgressStatus
+erase_file (FileOpTotalContext * tctx, FileOpContext * ctx, const char *s,
+            gboolean is_toplevel_file)
+{
+    file_progress_show_deleting (ctx, s);
+    if (check_progress_buttons (ctx) == FILE_ABORT)
+        return FILE_ABORT;
+    mc_refresh ();
+
+    return erase_shown_file (tctx, ctx, s, is_toplevel_file);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
 /**
   Recursive remove of files
   abort->cancel stack
@@ -1171,6 +1189,76 @@ panel_operate_init_totals (FileOperation operation,
     return status;
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Tell VFS that next marked files starting from panel entry 'start' are going
+ * to be read. Archive filesystem can extract them by one command instead of
+ * one command per file. Files are passed by batches of FILEOP_PREFETCH_FILES,
+ * so abort of operation is checked between batches.
+ *
+ * @return index of panel entry after the last one passed to VFS
+ */
+
+static int
+panel_operate_prefetch (FileOpContext * ctx, const WPanel * panel, int start)
+{
+    GPtrArray *names;
+    int i;
+
+    names = g_ptr_array_new ();
+
+    for (i = start; i < panel->count && names->len < FILEOP_PREFETCH_FILES; i++)
+        if (panel->dir.list[i].f.marked)
+            g_ptr_array_add (names, panel->dir.list[i].fname);
+
+    if (names->len > 1)
+    {
+        file_progress_show_source (ctx, (char *) g_ptr_array_index (names, 0));
+        file_progress_show_target (ctx, NULL);
+        mc_refresh ();
+        mc_setctl (panel->cwd, VFS_SETCTL_PREFETCH, names);
+    }
+
+    g_ptr_array_free (names, TRUE);
+    return i;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Pass up to FILEOP_UNLINK_FILES marked files (not directories) starting from start
+ * to VFS. Network filesystem can delete them at once instead of request per file.
+ * Since files are deleted here, they must be processed before abort is offered.
+ *
+ * @param batched set to TRUE if files were deleted by VFS
+ *
+ * @return index of panel entry after the last file passed to VFS
+ */
+
+static int
+panel_operate_batch_unlink (const WPanel * panel, int start, gboolean * batched)
+{
+    GPtrArray *names;
+    int i;
+    int end = start;
+
+    names = g_ptr_array_new ();
+
+    /* directory stops the batch, erase_dir() can be aborted */
+    for (i = start; i < panel->count && names->len < FILEOP_UNLINK_FILES; i++)
+        if (panel->dir.list[i].f.marked)
+        {
+            if (S_ISDIR (panel->dir.list[i].st.st_mode))
+                break;
+            g_ptr_array_add (names, panel->dir.list[i].fname);
+            end = i + 1;
+        }
+
+    *batched = names->len > 1 && mc_setctl (panel->cwd, VFS_SETCTL_BATCH_UNLINK, names) == 1;
+
+    g_ptr_array_free (names, TRUE);
+    return end;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 /**
  * Generate user prompt for panel operation.
@@ -2369,6 +2457,10 @@ panel_operate (void *source_panel, FileOperation operation, gboolean force_singl
     struct stat src_stat;
     gboolean ret_val = TRUE;
     int i;
+    int prefetch_end = 0;
+    int unlink_end = 0;
+    gboolean unlink_batched = FALSE;
+    gboolean unlink_abort = FALSE;
     FileProgressStatus value;
     FileOpContext *ctx;
     FileOpTotalContext *tctx;
@@ -2663,6 +2755,12 @@ panel_operate (void *source_panel, FileOperation operation, gboolean force_singl
                 if (!panel->dir.list[i].f.marked)
                     continue;   /* Skip the unmarked ones */
 
+                if (operation != OP_DELETE && i >= prefetch_end)
+                    prefetch_end = panel_operate_prefetch (ctx, panel, i);
+
+                if (operation == OP_DELETE && i >= unlink_end)
+                    unlink_end = panel_operate_batch_unlink (panel, i, &unlink_batched);
+
                 source = panel->dir.list[i].fname;
                 src_stat = panel->dir.list[i].st;
 
@@ -2678,6 +2776,13 @@ panel_operate (void *source_panel, FileOperation operation, gboolean force_singl
                 {
                     if (S_ISDIR (src_stat.st_mode))
                         value = erase_dir (tctx, ctx, source_with_path);
+                    else if (unlink_batched)
+                    {
+                        /* file is deleted already, its result is reported only */
+                        file_progress_show_deleting (ctx, source_with_path);
+                        mc_refresh ();
+                        value = erase_shown_file (tctx, ctx, source_with_path, 1);
+                    }
                     else
                         value = erase_file (tctx, ctx, source_with_path, 1);
                 }
@@ -2732,7 +2837,13 @@ panel_operate (void *source_panel, FileOperation operation, gboolean force_singl
                 }               /* Copy or move operation */
 
                 if (value == FILE_ABORT)
-                    break;
+                {
+                    if (!unlink_batched || i + 1 >= unlink_end)
+                        break;
+                    /* rest of batch is deleted already: report it without questions, then stop */
+                    ctx->skip_all = TRUE;
+                    unlink_abort = TRUE;
+                }
 
                 if (value == FILE_CONT)
                     do_file_mark (panel, i, 0);
@@ -2746,11 +2857,18 @@ panel_operate (void *source_panel, FileOperation operation, gboolean force_singl
                 if (operation != OP_DELETE)
                     file_progress_show (ctx, 0, 0, "", FALSE);
 
-                if (check_progress_buttons (ctx) == FILE_ABORT)
+                /* files deleted by VFS at once are processed before abort is offered */
+                if (unlink_batched && i + 1 < unlink_end)
+                    continue;
+
+                if (unlink_abort || check_progress_buttons (ctx) == FILE_ABORT)
                     break;
 
                 mc_refresh ();
             }                   /* Loop for every file */
+
+            if (operation == OP_DELETE)
+                mc_setctl (panel->cwd, VFS_SETCTL_BATCH_UNLINK, NULL);
         }
     }                           /* Many entries */
 
@@ -278,6 +278,7 @@ static const struct
     { "classic_progressbar", &classic_progressbar},
 #ifdef ENABLE_VFS
     { "vfs_timeout", &vfs_timeout },
+    { "vfs_memory_limit", &vfs_memory_limit },
 #ifdef ENABLE_VFS_FTP
     { "ftpfs_directory_timeout", &ftpfs_directory_timeout },
     { "use_netrc", &ftpfs_use_netrc },
@@ -287,9 +288,11 @@ static const struct
     { "ftpfs_use_passive_connections_over_proxy", &ftpfs_use_passive_connections_over_proxy },
     { "ftpfs_use_unix_list_options", &ftpfs_use_unix_list_options },
     { "ftpfs_first_cd_then_ls", &ftpfs_first_cd_then_ls },
+    { "ftpfs_max_connections", &ftpfs_max_connections },
 #endif /* ENABLE_VFS_FTP */
 #ifdef ENABLE_VFS_FISH
     { "fish_directory_timeout", &fish_directory_timeout },
+    { "fish_use_compression", &fish_use_compression },
 #endif /* ENABLE_VFS_FISH */
 #endif /* ENABLE_VFS */
     /* option_tab_spacing is used in internal viewer */
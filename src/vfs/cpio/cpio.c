@@ -53,16 +53,14 @@
 
 /*** file scope macro definitions ****************************************************************/
 
-#define CPIO_POS(super) cpio_position
-/* If some time reentrancy should be needed change it to */
-/* #define CPIO_POS(super) (super)->u.arch.fd */
+#define CPIO_POS(super) (((cpio_super_data_t *)(super)->data)->pos)
 
-#define CPIO_SEEK_SET(super, where) \
-        mc_lseek (((cpio_super_data_t *)(super)->data)->fd, \
-                  CPIO_POS(super) = (where), SEEK_SET)
-#define CPIO_SEEK_CUR(super, where) \
-        mc_lseek (((cpio_super_data_t *)(super)->data)->fd, \
-                  CPIO_POS(super) += (where), SEEK_SET)
+/* archive is read through buffer, so seek only moves position */
+#define CPIO_SEEK_SET(super, where) (CPIO_POS(super) = (where))
+#define CPIO_SEEK_CUR(super, where) (CPIO_POS(super) += (where))
+
+/* size of buffer used to read headers of archive */
+#define CPIO_BUF_SIZE (64 * 1024)
 
 #define MAGIC_LENGTH (6)        /* How many bytes we have to read ahead */
 #define SEEKBACK CPIO_SEEK_CUR(super, ptr - top)
@@ -129,8 +127,8 @@ struct new_cpio_header
 
 typedef struct
 {
-    unsigned long inumber;
-    unsigned short device;
+    ino_t inumber;
+    dev_t device;
     struct vfs_s_inode *inode;
 } defer_inode;
 
@@ -139,16 +137,19 @@ typedef struct
     int fd;
     struct stat st;
     int type;                   /* Type of the archive */
-    GSList *deferred;           /* List of inodes for which another entries may appear */
+    GHashTable *deferred;       /* Inodes for which another entries may appear, by (dev, ino) */
+    off_t pos;                  /* Current position in archive */
+    char *buf;                  /* Buffer used while archive is being loaded */
+    off_t buf_offset;           /* Position of buf in archive */
+    size_t buf_len;             /* Number of bytes in buf */
+    char *last_dir_name;        /* Directory of the last entry */
+    struct vfs_s_inode *last_dir;       /* and its inode */
 } cpio_super_data_t;
 
 /*** file scope variables ************************************************************************/
 
 static struct vfs_class vfs_cpiofs_ops;
 
-/* FIXME: should be off_t instead of int. */
-static int cpio_position;
-
 /*** file scope functions ************************************************************************/
 /* --------------------------------------------------------------------------------------------- */
 
@@ -160,18 +161,92 @@ static ssize_t cpio_read (void *fh, char *buffer, size_t count);
 
 /* --------------------------------------------------------------------------------------------- */
 
-static int
-cpio_defer_find (const void *a, const void *b)
+static guint
+cpio_defer_hash (gconstpointer a)
+{
+    const defer_inode *a1 = (const defer_inode *) a;
+
+    return (guint) a1->inumber ^ ((guint) a1->device * 31);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static gboolean
+cpio_defer_equal (gconstpointer a, gconstpointer b)
 {
     const defer_inode *a1 = (const defer_inode *) a;
     const defer_inode *b1 = (const defer_inode *) b;
 
-    return (a1->inumber == b1->inumber && a1->device == b1->device) ? 0 : 1;
+    return (a1->inumber == b1->inumber && a1->device == b1->device);
 }
 
 /* --------------------------------------------------------------------------------------------- */
+/**
+ * Read data from current position of archive through buffer.
+ *
+ * @return number of read bytes, -1 on error
+ */
 
-static int
+static ssize_t
+cpio_read_buffered (struct vfs_s_super *super, void *buffer, size_t count)
+{
+    cpio_super_data_t *arch = (cpio_super_data_t *) super->data;
+    size_t done = 0;
+
+    while (done < count)
+    {
+        size_t n;
+
+        if (arch->pos < arch->buf_offset
+            || arch->pos >= arch->buf_offset + (off_t) arch->buf_len)
+        {
+            ssize_t res;
+
+            /* fd is positioned at the end of buffer after the last read */
+            if (arch->pos != arch->buf_offset + (off_t) arch->buf_len
+                && mc_lseek (arch->fd, arch->pos, SEEK_SET) != arch->pos)
+                return (done != 0) ? (ssize_t) done : -1;
+
+            arch->buf_offset = arch->pos;
+            arch->buf_len = 0;
+
+            res = mc_read (arch->fd, arch->buf, CPIO_BUF_SIZE);
+            if (res <= 0)
+                return (done != 0 || res == 0) ? (ssize_t) done : -1;
+            arch->buf_len = (size_t) res;
+        }
+
+        n = MIN (count - done, arch->buf_len - (size_t) (arch->pos - arch->buf_offset));
+        memcpy ((char *) buffer + done, arch->buf + (arch->pos - arch->buf_offset), n);
+        arch->pos += n;
+        done += n;
+    }
+
+    return (ssize_t) done;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/** Free data needed only while archive is being loaded */
+
+static void
+cpio_free_load_data (cpio_super_data_t * arch)
+{
+    if (arch->deferred != NULL)
+    {
+        g_hash_table_destroy (arch->deferred);
+        arch->deferred = NULL;
+    }
+    g_free (arch->buf);
+    arch->buf = NULL;
+    arch->buf_len = 0;
+    g_free (arch->last_dir_name);
+    arch->last_dir_name = NULL;
+    arch->last_dir = NULL;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static off_t
 cpio_skip_padding (struct vfs_s_super *super)
 {
     switch (((cpio_super_data_t *) super->data)->type)
@@ -205,9 +280,7 @@ cpio_free_archive (struct vfs_class *me, struct vfs_s_super *super)
     if (arch->fd != -1)
         mc_close (arch->fd);
     arch->fd = -1;
-    g_slist_foreach (arch->deferred, (GFunc) g_free, NULL);
-    g_slist_free (arch->deferred);
-    arch->deferred = NULL;
+    cpio_free_load_data (arch);
     g_free (super->data);
     super->data = NULL;
 }
@@ -230,12 +303,13 @@ cpio_open_cpio_file (struct vfs_class *me, struct vfs_s_super *super, const char
     }
 
     super->name = g_strdup (name);
-    super->data = g_new (cpio_super_data_t, 1);
+    super->data = g_new0 (cpio_super_data_t, 1);
     arch = (cpio_super_data_t *) super->data;
     arch->fd = -1;              /* for now */
     mc_stat (name, &arch->st);
     arch->type = CPIO_UNKNOWN;
-    arch->deferred = NULL;
+    arch->deferred = g_hash_table_new_full (cpio_defer_hash, cpio_defer_equal, g_free, NULL);
+    arch->buf = g_malloc (CPIO_BUF_SIZE);
 
     type = get_compression_type (fd, name);
     if (type != COMPRESSION_NONE)
@@ -267,6 +341,8 @@ cpio_open_cpio_file (struct vfs_class *me, struct vfs_s_super *super, const char
 
     super->root = root;
 
+    /* position of fd must match the empty buffer */
+    mc_lseek (fd, 0, SEEK_SET);
     CPIO_SEEK_SET (super, 0);
 
     return fd;
@@ -300,15 +376,14 @@ cpio_read_head (struct vfs_class *me, struct vfs_s_super *super)
 static int
 cpio_find_head (struct vfs_class *me, struct vfs_s_super *super)
 {
-    cpio_super_data_t *arch = (cpio_super_data_t *) super->data;
     char buf[BUF_SMALL * 2];
     int ptr = 0;
     ssize_t top;
     ssize_t tmp;
 
-    top = mc_read (arch->fd, buf, sizeof (buf));
-    if (top > 0)
-        CPIO_POS (super) += top;
+    top = cpio_read_buffered (super, buf, sizeof (buf));
+    if (top < 0)
+        top = 0;
 
     while (TRUE)
     {
@@ -320,7 +395,7 @@ cpio_find_head (struct vfs_class *me, struct vfs_s_super *super)
                 ptr -= top - sizeof (buf) / 2;
                 top = sizeof (buf) / 2;
             }
-            tmp = mc_read (arch->fd, buf, top);
+            tmp = cpio_read_buffered (super, buf + top, sizeof (buf) - top);
             if (tmp == 0 || tmp == -1)
             {
                 message (D_ERROR, MSG_ERROR, _("Premature end of cpio archive\n%s"), super->name);
@@ -398,12 +473,12 @@ cpio_create_entry (struct vfs_class *me, struct vfs_s_super *super, struct stat
     if ((st->st_nlink > 1) && ((arch->type == CPIO_NEWC) || (arch->type == CPIO_CRC)))
     {                           /* For case of hardlinked files */
         defer_inode i = { st->st_ino, st->st_dev, NULL };
-        GSList *l;
+        defer_inode *l;
 
-        l = g_slist_find_custom (arch->deferred, &i, cpio_defer_find);
+        l = (defer_inode *) g_hash_table_lookup (arch->deferred, &i);
         if (l != NULL)
         {
-            inode = ((defer_inode *) l->data)->inode;
+            inode = l->inode;
             if (inode->st.st_size != 0 && st->st_size != 0 && (inode->st.st_size != st->st_size))
             {
                 message (D_ERROR, MSG_ERROR,
@@ -431,7 +506,16 @@ cpio_create_entry (struct vfs_class *me, struct vfs_s_super *super, struct stat
     else
     {
         *tn = '\0';
-        root = vfs_s_find_inode (me, super, name, LINK_FOLLOW, FL_MKDIR);
+        /* entries of one directory usually go one after another */
+        if (arch->last_dir != NULL && strcmp (arch->last_dir_name, name) == 0)
+            root = arch->last_dir;
+        else
+        {
+            root = vfs_s_find_inode (me, super, name, LINK_FOLLOW, FL_MKDIR);
+            g_free (arch->last_dir_name);
+            arch->last_dir_name = g_strdup (name);
+            arch->last_dir = root;
+        }
         *tn = PATH_SEP;
         tn++;
     }
@@ -467,7 +551,7 @@ cpio_create_entry (struct vfs_class *me, struct vfs_s_super *super, struct stat
         if (inode == NULL)
         {
             inode = vfs_s_new_inode (me, super, st);
-            if ((st->st_nlink > 0) && ((arch->type == CPIO_NEWC) || (arch->type == CPIO_CRC)))
+            if ((st->st_nlink > 1) && ((arch->type == CPIO_NEWC) || (arch->type == CPIO_CRC)))
             {
                 /* For case of hardlinked files */
                 defer_inode *i;
@@ -477,7 +561,8 @@ cpio_create_entry (struct vfs_class *me, struct vfs_s_super *super, struct stat
                 i->device = st->st_dev;
                 i->inode = inode;
 
-                arch->deferred = g_slist_prepend (arch->deferred, i);
+                /* key is also the value: replace both if (dev, ino) is already there */
+                g_hash_table_replace (arch->deferred, i, i);
             }
         }
 
@@ -495,14 +580,13 @@ cpio_create_entry (struct vfs_class *me, struct vfs_s_super *super, struct stat
         {
             inode->linkname = g_malloc (st->st_size + 1);
 
-            if (mc_read (arch->fd, inode->linkname, st->st_size) < st->st_size)
+            if (cpio_read_buffered (super, inode->linkname, st->st_size) < st->st_size)
             {
                 inode->linkname[0] = '\0';
                 return STATUS_EOF;
             }
 
             inode->linkname[st->st_size] = '\0';        /* Linkname stored without terminating \0 !!! */
-            CPIO_POS (super) += st->st_size;
             cpio_skip_padding (super);
         }
     }                           /* !entry */
@@ -526,10 +610,9 @@ cpio_read_bin_head (struct vfs_class *me, struct vfs_s_super *super)
     char *name;
     struct stat st;
 
-    len = mc_read (arch->fd, (char *) &u.buf, HEAD_LENGTH);
+    len = cpio_read_buffered (super, (char *) &u.buf, HEAD_LENGTH);
     if (len < HEAD_LENGTH)
         return STATUS_EOF;
-    CPIO_POS (super) += len;
     if (arch->type == CPIO_BINRE)
     {
         int i;
@@ -543,14 +626,13 @@ cpio_read_bin_head (struct vfs_class *me, struct vfs_s_super *super)
         return STATUS_FAIL;
     }
     name = g_malloc (u.buf.c_namesize);
-    len = mc_read (arch->fd, name, u.buf.c_namesize);
+    len = cpio_read_buffered (super, name, u.buf.c_namesize);
     if (len < u.buf.c_namesize)
     {
         g_free (name);
         return STATUS_EOF;
     }
     name[u.buf.c_namesize - 1] = '\0';
-    CPIO_POS (super) += len;
     cpio_skip_padding (super);
 
     if (!strcmp ("TRAILER!!!", name))
@@ -580,7 +662,6 @@ cpio_read_bin_head (struct vfs_class *me, struct vfs_s_super *super)
 static ssize_t
 cpio_read_oldc_head (struct vfs_class *me, struct vfs_s_super *super)
 {
-    cpio_super_data_t *arch = (cpio_super_data_t *) super->data;
     struct new_cpio_header hd;
     union
     {
@@ -590,9 +671,8 @@ cpio_read_oldc_head (struct vfs_class *me, struct vfs_s_super *super)
     ssize_t len;
     char *name;
 
-    if (mc_read (arch->fd, u.buf, HEAD_LENGTH) != HEAD_LENGTH)
+    if (cpio_read_buffered (super, u.buf, HEAD_LENGTH) != HEAD_LENGTH)
         return STATUS_EOF;
-    CPIO_POS (super) += HEAD_LENGTH;
     u.buf[HEAD_LENGTH] = 0;
 
     if (sscanf (u.buf, "070707%6lo%6lo%6lo%6lo%6lo%6lo%6lo%11lo%6lo%11lo",
@@ -610,14 +690,13 @@ cpio_read_oldc_head (struct vfs_class *me, struct vfs_s_super *super)
         return STATUS_FAIL;
     }
     name = g_malloc (hd.c_namesize);
-    len = mc_read (arch->fd, name, hd.c_namesize);
+    len = cpio_read_buffered (super, name, hd.c_namesize);
     if ((len == -1) || ((unsigned long) len < hd.c_namesize))
     {
         g_free (name);
         return STATUS_EOF;
     }
     name[hd.c_namesize - 1] = '\0';
-    CPIO_POS (super) += len;
     cpio_skip_padding (super);
 
     if (!strcmp ("TRAILER!!!", name))
@@ -657,10 +736,9 @@ cpio_read_crc_head (struct vfs_class *me, struct vfs_s_super *super)
     ssize_t len;
     char *name;
 
-    if (mc_read (arch->fd, u.buf, HEAD_LENGTH) != HEAD_LENGTH)
+    if (cpio_read_buffered (super, u.buf, HEAD_LENGTH) != HEAD_LENGTH)
         return STATUS_EOF;
 
-    CPIO_POS (super) += HEAD_LENGTH;
     u.buf[HEAD_LENGTH] = '\0';
 
     if (sscanf (u.buf, "%6ho%8lx%8lx%8lx%8lx%8lx%8lx%8lx%8lx%8lx%8lx%8lx%8lx%8lx",
@@ -685,7 +763,7 @@ cpio_read_crc_head (struct vfs_class *me, struct vfs_s_super *super)
     }
 
     name = g_malloc (hd.c_namesize);
-    len = mc_read (arch->fd, name, hd.c_namesize);
+    len = cpio_read_buffered (super, name, hd.c_namesize);
 
     if ((len == -1) || ((unsigned long) len < hd.c_namesize))
     {
@@ -693,7 +771,6 @@ cpio_read_crc_head (struct vfs_class *me, struct vfs_s_super *super)
         return STATUS_EOF;
     }
     name[hd.c_namesize - 1] = '\0';
-    CPIO_POS (super) += len;
     cpio_skip_padding (super);
 
     if (strcmp ("TRAILER!!!", name) == 0)
@@ -741,7 +818,7 @@ cpio_open_archive (struct vfs_s_super *super, const vfs_path_t * vpath,
         {
         case STATUS_EOF:
             message (D_ERROR, MSG_ERROR, _("Unexpected end of file\n%s"), archive_name);
-            return 0;
+            break;
         case STATUS_OK:
             continue;
         case STATUS_TRAIL:
@@ -750,6 +827,10 @@ cpio_open_archive (struct vfs_s_super *super, const vfs_path_t * vpath,
         break;
     }
 
+    /* the tree is built, drop the buffer and hardlink index */
+    if (super->data != NULL)
+        cpio_free_load_data ((cpio_super_data_t *) super->data);
+
     g_free (archive_name);
     return 0;
 }
@@ -46,11 +46,15 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <time.h>
 #include <signal.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <inttypes.h>           /* uintmax_t */
 
 #include "lib/global.h"
 #include "lib/fileloc.h"
@@ -78,8 +82,26 @@ GArray *extfs_plugins = NULL;
 
 #define RECORDSIZE 512
 
+/* cached listings unused for this time (in seconds) are removed */
+#define EXTFS_CACHE_MAX_AGE (30 * 24 * 60 * 60)
+/* total size of cached listings */
+#define EXTFS_CACHE_MAX_SIZE (64 * 1024 * 1024)
+
+/* total size of files extracted by one 'copyoutlist' command */
+#define EXTFS_PREFETCH_MAX_SIZE (64 * 1024 * 1024)
+
+/* exit status of plugin for unknown command */
+#define EXTFS_UNKNOWN_COMMAND 1
+
 /*** file scope type declarations ****************************************************************/
 
+typedef struct
+{
+    char *name;
+    time_t mtime;
+    off_t size;
+} extfs_cache_file_t;
+
 struct inode
 {
     nlink_t nlink;
@@ -98,6 +120,7 @@ struct inode
     time_t atime;
     time_t ctime;
     char *local_filename;
+    gboolean prefetched;        /* local_filename is made by copyoutlist and isn't read yet */
 };
 
 struct entry
@@ -134,6 +157,7 @@ typedef struct
     char *path;
     char *prefix;
     gboolean need_archive;
+    gboolean no_copyoutlist;    /* plugin failed 'copyoutlist' command */
 } extfs_plugin_info_t;
 
 /*** file scope variables ************************************************************************/
@@ -167,6 +191,7 @@ extfs_make_dots (struct entry *ent)
     entry->inode = inode;
     entry->dir = ent;
     inode->local_filename = NULL;
+    inode->prefetched = FALSE;
     inode->first_in_subdir = entry;
     inode->nlink++;
 
@@ -213,6 +238,7 @@ extfs_generate_entry (struct archive *archive,
     inode = g_new (struct inode, 1);
     entry->inode = inode;
     inode->local_filename = NULL;
+    inode->prefetched = FALSE;
     inode->linkname = NULL;
     inode->last_in_subdir = NULL;
     inode->inode = (archive->inode_counter)++;
@@ -385,9 +411,285 @@ extfs_free_archive (struct archive *archive)
 }
 
 /* --------------------------------------------------------------------------------------------- */
+/**
+ * Header of cached listing of archive. It identifies plugin and archive and their state,
+ * so listing of changed archive or made by changed plugin isn't used.
+ */
+
+static char *
+extfs_cache_header (const extfs_plugin_info_t * info, const char *name, const struct stat *st)
+{
+    struct stat plugin_st;
+    char *plugin;
+    char *header;
+
+    plugin = g_strconcat (info->path, info->prefix, (char *) NULL);
+    if (stat (plugin, &plugin_st) != 0)
+        plugin_st.st_mtime = 0;
+    g_free (plugin);
+
+    header = g_strdup_printf ("%s\n%s\n%" PRIuMAX " %" PRIuMAX " %" PRIuMAX "\n",
+                              info->prefix, name, (uintmax_t) st->st_size,
+                              (uintmax_t) st->st_mtime, (uintmax_t) plugin_st.st_mtime);
+    return header;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Name of cached listing. It depends on plugin and archive name only,
+ * so listing of changed archive replaces the old one.
+ */
+
+static char *
+extfs_cache_name (const char *header)
+{
+    char *dir, *key, *base, *name;
+
+    dir = concat_dir_and_file (mc_config_get_cache_path (), MC_EXTFS_CACHE_DIR);
+    if (mkdir (dir, 0700) == -1 && errno != EEXIST)
+    {
+        g_free (dir);
+        return NULL;
+    }
+
+    /* first two lines of header: plugin and archive name */
+    key = g_strndup (header, strchr (strchr (header, '\n') + 1, '\n') - header);
+    base = g_strdup_printf ("%08x", g_str_hash (key));
+    name = concat_dir_and_file (dir, base);
+    g_free (base);
+    g_free (key);
+    g_free (dir);
+
+    return name;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Open cached listing of archive.
+ *
+ * @return stream positioned after header or NULL if there is no valid listing
+ */
+
+static FILE *
+extfs_cache_open (const char *header)
+{
+    char *name;
+    FILE *f;
+    char *buf;
+    size_t len;
+
+    name = extfs_cache_name (header);
+    if (name == NULL)
+        return NULL;
+
+    f = fopen (name, "r");
+    if (f == NULL)
+    {
+        g_free (name);
+        return NULL;
+    }
+
+    len = strlen (header);
+    buf = g_malloc (len);
+    if (fread (buf, 1, len, f) != len || memcmp (buf, header, len) != 0)
+    {
+        fclose (f);
+        f = NULL;
+    }
+    else
+        /* mtime is the time of last use for extfs_cache_cleanup() */
+        utime (name, NULL);
+    g_free (buf);
+    g_free (name);
+
+    return f;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Create temporary file for listing of archive. It becomes the cached listing
+ * in extfs_cache_close() if listing is read successfully.
+ */
+
+static FILE *
+extfs_cache_create (const char *header, char **tmp_name)
+{
+    char *name;
+    int fd;
+    FILE *f;
+
+    *tmp_name = NULL;
+
+    name = extfs_cache_name (header);
+    if (name == NULL)
+        return NULL;
+
+    fd = mc_mkstemps (tmp_name, name, NULL);
+    g_free (name);
+    if (fd == -1)
+        return NULL;
+
+    f = fdopen (fd, "w");
+    if (f == NULL)
+    {
+        close (fd);
+        unlink (*tmp_name);
+        g_free (*tmp_name);
+        *tmp_name = NULL;
+        return NULL;
+    }
+
+    fputs (header, f);
+    return f;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+extfs_cache_close (FILE * f, char *tmp_name, const char *header, gboolean ok)
+{
+    char *name = NULL;
+
+    ok = !ferror (f) && ok;
+    ok = (fclose (f) == 0) && ok;
+
+    if (ok)
+        name = extfs_cache_name (header);
+    if (name == NULL || rename (tmp_name, name) != 0)
+        unlink (tmp_name);
+
+    g_free (name);
+    g_free (tmp_name);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+extfs_cache_file_cmp (gconstpointer a, gconstpointer b)
+{
+    const extfs_cache_file_t *fa = *(const extfs_cache_file_t * const *) a;
+    const extfs_cache_file_t *fb = *(const extfs_cache_file_t * const *) b;
+
+    /* most recently used first */
+    return (fa->mtime > fb->mtime) ? -1 : (fa->mtime < fb->mtime) ? 1 : 0;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Remove cached listings which were not used for EXTFS_CACHE_MAX_AGE and
+ * least recently used ones over EXTFS_CACHE_MAX_SIZE.
+ */
+
+static void
+extfs_cache_cleanup (void)
+{
+    char *dir;
+    DIR *d;
+    struct dirent *de;
+    GPtrArray *files;
+    time_t now;
+    off_t total = 0;
+    guint i;
+
+    dir = concat_dir_and_file (mc_config_get_cache_path (), MC_EXTFS_CACHE_DIR);
+    d = opendir (dir);
+    if (d == NULL)
+    {
+        g_free (dir);
+        return;
+    }
+
+    files = g_ptr_array_new ();
+
+    while ((de = readdir (d)) != NULL)
+    {
+        struct stat st;
+        char *name;
+
+        if (strcmp (de->d_name, ".") == 0 || strcmp (de->d_name, "..") == 0)
+            continue;
+
+        name = concat_dir_and_file (dir, de->d_name);
+        if (stat (name, &st) == 0 && S_ISREG (st.st_mode))
+        {
+            extfs_cache_file_t *f;
+
+            f = g_new (extfs_cache_file_t, 1);
+            f->name = name;
+            f->mtime = st.st_mtime;
+            f->size = st.st_size;
+            g_ptr_array_add (files, f);
+        }
+        else
+            g_free (name);
+    }
+    closedir (d);
+    g_free (dir);
+
+    g_ptr_array_sort (files, extfs_cache_file_cmp);
+
+    now = time (NULL);
+    for (i = 0; i < files->len; i++)
+    {
+        extfs_cache_file_t *f = (extfs_cache_file_t *) g_ptr_array_index (files, i);
+
+        total += f->size;
+        if (total > EXTFS_CACHE_MAX_SIZE || now - f->mtime > EXTFS_CACHE_MAX_AGE)
+            unlink (f->name);
+
+        g_free (f->name);
+        g_free (f);
+    }
+
+    g_ptr_array_free (files, TRUE);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Get local copy of non-local archive, if it isn't got yet.
+ *
+ * @return FALSE if local copy is needed but can't be got
+ */
+
+static gboolean
+extfs_get_local_copy (struct archive *archive)
+{
+    const extfs_plugin_info_t *info;
+    vfs_path_t *vpath;
+    gboolean local;
+
+    if (archive->local_name != NULL || archive->name == NULL)
+        return TRUE;
+
+    info = &g_array_index (extfs_plugins, extfs_plugin_info_t, archive->fstype);
+    if (!info->need_archive)
+        return TRUE;
+
+    vpath = vfs_path_from_str (archive->name);
+    local = vfs_file_is_local (vpath);
+    vfs_path_free (vpath);
+    if (local)
+        return TRUE;
+
+    archive->local_name = mc_getlocalcopy (archive->name);
+    if (archive->local_name == NULL)
+        return FALSE;
+
+    mc_stat (archive->local_name, &archive->local_stat);
+    return TRUE;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Run 'list' command of plugin or open cached listing of archive.
+ *
+ * @param header  header of cached listing; NULL if listing of archive can't be cached
+ * @param cached  TRUE if cached listing is opened, FALSE if output of 'list' command is returned
+ */
 
 static FILE *
-extfs_open_archive (int fstype, const char *name, struct archive **pparc)
+extfs_open_archive (int fstype, const char *name, struct archive **pparc, char **header,
+                    gboolean * cached)
 {
     const extfs_plugin_info_t *info;
     static dev_t archive_counter = 0;
@@ -407,30 +709,53 @@ extfs_open_archive (int fstype, const char *name, struct archive **pparc)
 
     info = &g_array_index (extfs_plugins, extfs_plugin_info_t, fstype);
 
+    *header = NULL;
+    *cached = FALSE;
+
     if (info->need_archive)
     {
         if (mc_stat (name, &mystat) == -1)
+        {
+            vfs_path_free (vpath);
             return NULL;
+        }
 
-        if (!vfs_file_is_local (vpath))
+        /* header is made from stat of the original archive, so cached listing
+           of non-local archive is used without getting its local copy */
+        *header = extfs_cache_header (info, name, &mystat);
+        result = extfs_cache_open (*header);
+        if (result != NULL)
+            *cached = TRUE;
+        else if (!vfs_file_is_local (vpath))
         {
             local_name = mc_getlocalcopy (name);
             if (local_name == NULL)
+            {
+                g_free (*header);
+                *header = NULL;
+                vfs_path_free (vpath);
                 return NULL;
+            }
         }
         tmp = name_quote ((vpath != NULL) ? path_element->path : name, 0);
     }
-
-    cmd = g_strconcat (info->path, info->prefix, " list ",
-                       local_name != NULL ? local_name : tmp, (char *) NULL);
-    g_free (tmp);
+    else
+        result = NULL;
 
     open_error_pipe ();
-    result = popen (cmd, "r");
-    g_free (cmd);
+    if (result == NULL)
+    {
+        cmd = g_strconcat (info->path, info->prefix, " list ",
+                           local_name != NULL ? local_name : tmp, (char *) NULL);
+        result = popen (cmd, "r");
+        g_free (cmd);
+    }
+    g_free (tmp);
     if (result == NULL)
     {
         close_error_pipe (D_ERROR, NULL);
+        g_free (*header);
+        *header = NULL;
         if (local_name != NULL)
         {
             mc_ungetlocalcopy (name, local_name, 0);
@@ -478,6 +803,28 @@ extfs_open_archive (int fstype, const char *name, struct archive **pparc)
     return result;
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Close listing opened by extfs_open_archive() and finish its caching.
+ *
+ * @return exit status of 'list' command
+ */
+
+static int
+extfs_close_listing (FILE * extfsd, gboolean cached, FILE * cache, char *cache_name,
+                     char *header, gboolean ok)
+{
+    int status;
+
+    status = cached ? fclose (extfsd) : pclose (extfsd);
+
+    if (cache != NULL)
+        extfs_cache_close (cache, cache_name, header, ok && status == 0);
+    g_free (header);
+
+    return status;
+}
+
 /* --------------------------------------------------------------------------------------------- */
 /**
  * Main loop for reading an archive.
@@ -492,10 +839,15 @@ extfs_read_archive (int fstype, const char *name, struct archive **pparc)
     char *buffer;
     struct archive *current_archive;
     char *current_file_name, *current_link_name;
+    char *header;
+    gboolean cached;
+    FILE *cache = NULL;
+    char *cache_name = NULL;
+    int status;
 
     info = &g_array_index (extfs_plugins, extfs_plugin_info_t, fstype);
 
-    extfsd = extfs_open_archive (fstype, name, &current_archive);
+    extfsd = extfs_open_archive (fstype, name, &current_archive, &header, &cached);
 
     if (extfsd == NULL)
     {
@@ -503,11 +855,18 @@ extfs_read_archive (int fstype, const char *name, struct archive **pparc)
         return -1;
     }
 
+    /* output of 'list' command is stored to be reused while archive isn't changed */
+    if (!cached && header != NULL)
+        cache = extfs_cache_create (header, &cache_name);
+
     buffer = g_malloc (BUF_4K);
     while (fgets (buffer, BUF_4K, extfsd) != NULL)
     {
         struct stat hstat;
 
+        if (cache != NULL)
+            fputs (buffer, cache);
+
         current_link_name = NULL;
         if (vfs_parse_ls_lga (buffer, &hstat, &current_file_name, &current_link_name, NULL))
         {
@@ -540,7 +899,7 @@ extfs_read_archive (int fstype, const char *name, struct archive **pparc)
                 {
                     /* FIXME: Should clean everything one day */
                     g_free (buffer);
-                    pclose (extfsd);
+                    extfs_close_listing (extfsd, cached, cache, cache_name, header, FALSE);
                     close_error_pipe (D_ERROR, _("Inconsistent extfs archive"));
                     return -1;
                 }
@@ -561,7 +920,7 @@ extfs_read_archive (int fstype, const char *name, struct archive **pparc)
                     {
                         /* FIXME: Should clean everything one day */
                         g_free (buffer);
-                        pclose (extfsd);
+                        extfs_close_listing (extfsd, cached, cache, cache_name, header, FALSE);
                         close_error_pipe (D_ERROR, _("Inconsistent extfs archive"));
                         return -1;
                     }
@@ -574,6 +933,7 @@ extfs_read_archive (int fstype, const char *name, struct archive **pparc)
                     inode = g_new (struct inode, 1);
                     entry->inode = inode;
                     inode->local_filename = NULL;
+                    inode->prefetched = FALSE;
                     inode->inode = (current_archive->inode_counter)++;
                     inode->nlink = 1;
                     inode->dev = current_archive->rdev;
@@ -615,7 +975,8 @@ extfs_read_archive (int fstype, const char *name, struct archive **pparc)
     g_free (buffer);
 
     /* Check if extfs 'list' returned 0 */
-    if (pclose (extfsd) != 0)
+    status = extfs_close_listing (extfsd, cached, cache, cache_name, header, TRUE);
+    if (status != 0)
     {
         extfs_free (current_archive);
         close_error_pipe (D_ERROR, _("Inconsistent extfs archive"));
@@ -797,6 +1158,9 @@ extfs_get_archive_name (struct archive *archive)
 {
     const char *archive_name;
 
+    /* listing of archive may be read from cache without local copy */
+    extfs_get_local_copy (archive);
+
     if (archive->local_name)
         archive_name = archive->local_name;
     else
@@ -852,6 +1216,213 @@ extfs_cmd (const char *str_extfs_cmd, struct archive *archive,
     return retval;
 }
 
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Collect regular files of entry (recursively) which aren't extracted yet
+ * while their total size doesn't exceed EXTFS_PREFETCH_MAX_SIZE.
+ */
+
+static void
+extfs_prefetch_collect (struct entry *entry, GPtrArray * entries, GHashTable * inodes,
+                        off_t * total)
+{
+    struct inode *inode = entry->inode;
+
+    if (S_ISDIR (inode->mode))
+    {
+        struct entry *e;
+
+        for (e = inode->first_in_subdir; e != NULL && *total <= EXTFS_PREFETCH_MAX_SIZE;
+             e = e->next_in_dir)
+            if (strcmp (e->name, ".") != 0 && strcmp (e->name, "..") != 0)
+                extfs_prefetch_collect (e, entries, inodes, total);
+    }
+    else if (S_ISREG (inode->mode) && inode->local_filename == NULL
+             && g_hash_table_lookup (inodes, inode) == NULL
+             && *total + inode->size <= EXTFS_PREFETCH_MAX_SIZE)
+    {
+        /* hardlinks share inode, it is extracted once */
+        g_hash_table_insert (inodes, inode, inode);
+        g_ptr_array_add (entries, entry);
+        *total += inode->size;
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Extract files of archive by one 'copyoutlist' command of plugin.
+ * The command gets archive and file with pairs of lines: name of file in archive
+ * and name of local file to extract it to.
+ *
+ * @return exit status of command, -1 if it isn't run
+ */
+
+static int
+extfs_copyoutlist (struct archive *archive, GPtrArray * entries, char **local_names)
+{
+    const extfs_plugin_info_t *info;
+    char *list_name;
+    char *archive_name, *quoted_archive_name, *quoted_list_name;
+    char *cmd;
+    int fd;
+    FILE *f;
+    guint i;
+    int retval;
+
+    fd = mc_mkstemps (&list_name, "extfs", NULL);
+    if (fd == -1)
+        return -1;
+
+    f = fdopen (fd, "w");
+    if (f == NULL)
+    {
+        close (fd);
+        unlink (list_name);
+        g_free (list_name);
+        return -1;
+    }
+
+    for (i = 0; i < entries->len; i++)
+        if (local_names[i] != NULL)
+        {
+            char *file;
+
+            file = extfs_get_path_from_entry ((struct entry *) g_ptr_array_index (entries, i));
+            fprintf (f, "%s\n%s\n", file, local_names[i]);
+            g_free (file);
+        }
+
+    if (ferror (f) != 0 || fclose (f) != 0)
+    {
+        unlink (list_name);
+        g_free (list_name);
+        return -1;
+    }
+
+    archive_name = extfs_get_archive_name (archive);
+    quoted_archive_name = name_quote (archive_name, 0);
+    g_free (archive_name);
+    quoted_list_name = name_quote (list_name, 0);
+    info = &g_array_index (extfs_plugins, extfs_plugin_info_t, archive->fstype);
+    /* errors are shown by 'copyout' of files which are failed to extract here */
+    cmd = g_strconcat (info->path, info->prefix, " copyoutlist ", quoted_archive_name, " ",
+                       quoted_list_name, " 2>/dev/null", (char *) NULL);
+    g_free (quoted_list_name);
+    g_free (quoted_archive_name);
+
+    retval = my_system (EXECUTE_AS_SHELL, shell, cmd);
+    g_free (cmd);
+    unlink (list_name);
+    g_free (list_name);
+
+    return retval;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Extract given files of directory (and files of given subdirectories) at once,
+ * if plugin supports 'copyoutlist' command. Then extfs_open() of these files
+ * doesn't run 'copyout' command of plugin for every file.
+ */
+
+static void
+extfs_prefetch (const vfs_path_t * vpath, GPtrArray * names)
+{
+    extfs_plugin_info_t *info;
+    struct archive *archive = NULL;
+    struct entry *dir;
+    char *q;
+    GPtrArray *entries;
+    GHashTable *inodes;
+    char **local_names;
+    off_t total = 0;
+    guint i;
+
+    q = extfs_get_path (vpath, &archive, FALSE);
+    if (q == NULL)
+        return;
+
+    info = &g_array_index (extfs_plugins, extfs_plugin_info_t, archive->fstype);
+    dir = info->no_copyoutlist ? NULL : extfs_find_entry (archive->root_entry, q, FALSE, FALSE);
+    g_free (q);
+    if (dir != NULL)
+        dir = extfs_resolve_symlinks (dir);
+    if (dir == NULL || !S_ISDIR (dir->inode->mode))
+        return;
+
+    entries = g_ptr_array_new ();
+    inodes = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    for (i = 0; i < names->len; i++)
+    {
+        struct entry *entry;
+
+        entry = extfs_find_entry (dir, (char *) g_ptr_array_index (names, i), FALSE, FALSE);
+        if (entry != NULL)
+            entry = extfs_resolve_symlinks (entry);
+        if (entry != NULL)
+            extfs_prefetch_collect (entry, entries, inodes, &total);
+    }
+
+    g_hash_table_destroy (inodes);
+
+    /* nothing to save if there is one file only */
+    if (entries->len < 2)
+    {
+        g_ptr_array_free (entries, TRUE);
+        return;
+    }
+
+    local_names = g_new0 (char *, entries->len);
+
+    for (i = 0; i < entries->len; i++)
+    {
+        struct entry *entry = (struct entry *) g_ptr_array_index (entries, i);
+        char *file;
+        int local_handle;
+
+        /* names are passed line by line */
+        file = extfs_get_path_from_entry (entry);
+        if (strchr (file, '\n') == NULL)
+        {
+            local_handle = vfs_mkstemps (&local_names[i], "extfs", entry->name);
+            if (local_handle != -1)
+                close (local_handle);
+        }
+        g_free (file);
+    }
+
+    /* plugin doesn't support the command, don't try it again */
+    if (extfs_copyoutlist (archive, entries, local_names) == EXTFS_UNKNOWN_COMMAND)
+        info->no_copyoutlist = TRUE;
+    else
+        /* command may fail for some files only */
+        for (i = 0; i < entries->len; i++)
+        {
+            struct entry *entry = (struct entry *) g_ptr_array_index (entries, i);
+            struct stat st;
+
+            if (local_names[i] != NULL && stat (local_names[i], &st) == 0
+                && st.st_size == entry->inode->size)
+            {
+                entry->inode->local_filename = local_names[i];
+                entry->inode->prefetched = TRUE;
+                local_names[i] = NULL;
+            }
+        }
+
+    /* files failed to extract are extracted by extfs_open() */
+    for (i = 0; i < entries->len; i++)
+        if (local_names[i] != NULL)
+        {
+            unlink (local_names[i]);
+            g_free (local_names[i]);
+        }
+
+    g_free (local_names);
+    g_ptr_array_free (entries, TRUE);
+}
+
 /* --------------------------------------------------------------------------------------------- */
 
 static void
@@ -913,6 +1484,10 @@ extfs_open (const vfs_path_t * vpath, int flags, mode_t mode)
     if (S_ISDIR (entry->inode->mode))
         ERRNOR (EISDIR, NULL);
 
+    /* file is changed, its local copy is kept until archive is freed */
+    if ((flags & (O_WRONLY | O_RDWR)) != 0)
+        entry->inode->prefetched = FALSE;
+
     if (entry->inode->local_filename == NULL)
     {
         char *local_filename;
@@ -994,6 +1569,14 @@ extfs_close (void *data)
 
         file->entry->inode->mtime = time (NULL);
     }
+    else if (file->entry->inode->prefetched)
+    {
+        /* file extracted by copyoutlist is read, don't keep its copy on disk */
+        unlink (file->entry->inode->local_filename);
+        g_free (file->entry->inode->local_filename);
+        file->entry->inode->local_filename = NULL;
+        file->entry->inode->prefetched = FALSE;
+    }
 
     if (--file->archive->fd_usage == 0)
         vfs_stamp_create (&vfs_extfs_ops, file->archive);
@@ -1509,6 +2092,8 @@ extfs_getlocalcopy (const vfs_path_t * vpath)
         return NULL;
     }
     p = g_strdup (fp->entry->inode->local_filename);
+    /* local copy is used outside of extfs, keep it */
+    fp->entry->inode->prefetched = FALSE;
     fp->archive->fd_usage++;
     extfs_close ((void *) fp);
     return p;
@@ -1596,6 +2181,7 @@ extfs_get_plugins (const char *where, gboolean silent)
                  */
                 len = strlen (filename);
                 info.need_archive = (filename[len - 1] != '+');
+                info.no_copyoutlist = FALSE;
                 info.path = g_strconcat (dirname, PATH_SEP_STR, (char *) NULL);
                 info.prefix = g_strdup (filename);
 
@@ -1674,6 +2260,8 @@ extfs_done (struct vfs_class *me)
         ar = first_archive;
     }
 
+    extfs_cache_cleanup ();
+
     for (i = 0; i < extfs_plugins->len; i++)
     {
         extfs_plugin_info_t *info;
@@ -1692,14 +2280,17 @@ extfs_done (struct vfs_class *me)
 static int
 extfs_setctl (const vfs_path_t * vpath, int ctlop, void *arg)
 {
-    (void) arg;
-
-    if (ctlop == VFS_SETCTL_RUN)
+    switch (ctlop)
     {
+    case VFS_SETCTL_RUN:
         extfs_run (vpath);
         return 1;
+    case VFS_SETCTL_PREFETCH:
+        extfs_prefetch (vpath, (GPtrArray *) arg);
+        return 1;
+    default:
+        return 0;
     }
-    return 0;
 }
 
 /* --------------------------------------------------------------------------------------------- */
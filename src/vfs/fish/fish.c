@@ -64,6 +64,7 @@
 #include "lib/global.h"
 #include "lib/tty/tty.h"        /* enable/disable interrupt key */
 #include "lib/strescape.h"
+#include "lib/util.h"           /* concat_dir_and_file */
 #include "lib/unixcompat.h"
 #include "lib/fileloc.h"
 #include "lib/mcconfig.h"
@@ -83,6 +84,9 @@
 
 int fish_directory_timeout = 900;
 
+/* Compress all traffic of ssh connections by ssh itself, like the 'C' option of URL does */
+int fish_use_compression = 0;
+
 /*** file scope macro definitions ****************************************************************/
 
 #define DO_RESOLVE_SYMLINK 1
@@ -126,6 +130,7 @@ typedef struct
 {
     int sockr;
     int sockw;
+    vfs_s_reader_t *reader;     /* buffered reader of sockr */
     char *scr_ls;
     char *scr_chmod;
     char *scr_exists;
@@ -142,6 +147,7 @@ typedef struct
     char *scr_info;
     int host_flags;
     char *scr_env;
+    GHashTable *unlinked;       /* replies to batched deletion: remote path -> reply code */
 } fish_super_data_t;
 
 typedef struct
@@ -208,14 +214,14 @@ fish_decode_reply (char *s, int was_garbage)
 /* Returns a reply code, check /usr/include/arpa/ftp.h for possible values */
 
 static int
-fish_get_reply (struct vfs_class *me, int sock, char *string_buf, int string_len)
+fish_get_reply (struct vfs_class *me, vfs_s_reader_t * reader, char *string_buf, int string_len)
 {
     char answer[BUF_1K];
     int was_garbage = 0;
 
     for (;;)
     {
-        if (!vfs_s_get_line (me, sock, answer, sizeof (answer), '\n'))
+        if (!vfs_s_get_line (me, reader, answer, sizeof (answer), '\n'))
         {
             if (string_buf)
                 *string_buf = 0;
@@ -265,7 +271,7 @@ fish_command (struct vfs_class *me, struct vfs_s_super *super, int wait_reply, c
         return TRANSIENT;
 
     if (wait_reply)
-        return fish_get_reply (me, SUP->sockr,
+        return fish_get_reply (me, SUP->reader,
                                (wait_reply & WANT_STRING) ? reply_str :
                                NULL, sizeof (reply_str) - 1);
     return COMPLETE;
@@ -284,6 +290,8 @@ fish_free_archive (struct vfs_class *me, struct vfs_s_super *super)
         close (SUP->sockr);
         SUP->sockw = SUP->sockr = -1;
     }
+    if (SUP->reader != NULL)
+        vfs_s_reader_free (SUP->reader);
     g_free (SUP->scr_ls);
     g_free (SUP->scr_exists);
     g_free (SUP->scr_mkdir);
@@ -299,6 +307,8 @@ fish_free_archive (struct vfs_class *me, struct vfs_s_super *super)
     g_free (SUP->scr_append);
     g_free (SUP->scr_info);
     g_free (SUP->scr_env);
+    if (SUP->unlinked != NULL)
+        g_hash_table_destroy (SUP->unlinked);
     g_free (SUP);
     super->data = NULL;
 }
@@ -325,6 +335,7 @@ fish_pipeopen (struct vfs_s_super *super, const char *path, const char *argv[])
         SUP->sockw = fileset1[1];
         close (fileset2[1]);
         SUP->sockr = fileset2[0];
+        SUP->reader = vfs_s_reader_new (SUP->sockr);
     }
     else
     {
@@ -388,7 +399,7 @@ fish_info (struct vfs_class *me, struct vfs_s_super *super)
         {
             int res;
 
-            res = vfs_s_get_line_interruptible (me, buffer, sizeof (buffer), SUP->sockr);
+            res = vfs_s_get_line_interruptible (me, buffer, sizeof (buffer), SUP->reader);
             if ((res == 0) || (res == EINTR))
                 ERRNOR (ECONNRESET, FALSE);
             if (strncmp (buffer, "### ", 4) == 0)
@@ -424,7 +435,8 @@ fish_open_archive_pipeopen (struct vfs_s_super *super)
     int i = 0;
 
     argv[i++] = xsh;
-    if (super->path_element->port == FISH_FLAG_COMPRESSED)
+    if (super->path_element->port == FISH_FLAG_COMPRESSED
+        || (fish_use_compression && super->path_element->port != FISH_FLAG_RSH))
         argv[i++] = "-C";
 
     if (super->path_element->port > FISH_FLAG_RSH)
@@ -468,7 +480,7 @@ fish_open_archive_talk (struct vfs_class *me, struct vfs_s_super *super)
 
     printf ("\n%s\n", _("fish: Waiting for initial line..."));
 
-    if (!vfs_s_get_line (me, SUP->sockr, answer, sizeof (answer), ':'))
+    if (!vfs_s_get_line (me, SUP->reader, answer, sizeof (answer), ':'))
         return FALSE;
 
     if (strstr (answer, "assword") != NULL)
@@ -686,7 +698,7 @@ fish_dir_load (struct vfs_class *me, struct vfs_s_inode *dir, char *remote_path)
     ent = vfs_s_generate_entry (me, NULL, dir, 0);
     while (TRUE)
     {
-        int res = vfs_s_get_line_interruptible (me, buffer, sizeof (buffer), SUP->sockr);
+        int res = vfs_s_get_line_interruptible (me, buffer, sizeof (buffer), SUP->reader);
         if ((!res) || (res == EINTR))
         {
             vfs_s_free_entry (me, ent);
@@ -968,13 +980,13 @@ fish_file_store (struct vfs_class *me, vfs_file_handler_t * fh, char *name, char
     close (h);
     g_free (quoted_name);
 
-    if ((fish_get_reply (me, SUP->sockr, NULL, 0) != COMPLETE) || was_error)
+    if ((fish_get_reply (me, SUP->reader, NULL, 0) != COMPLETE) || was_error)
         ERRNOR (E_REMOTE, -1);
     return 0;
 
   error_return:
     close (h);
-    fish_get_reply (me, SUP->sockr, NULL, 0);
+    fish_get_reply (me, SUP->reader, NULL, 0);
     g_free (quoted_name);
     return -1;
 }
@@ -1047,7 +1059,7 @@ fish_linear_abort (struct vfs_class *me, vfs_file_handler_t * fh)
         n = MIN (sizeof (buffer), (size_t) (fish->total - fish->got));
         if (n != 0)
         {
-            n = read (SUP->sockr, buffer, n);
+            n = vfs_s_reader_read (SUP->reader, buffer, n);
             if (n < 0)
                 return;
             fish->got += n;
@@ -1055,7 +1067,7 @@ fish_linear_abort (struct vfs_class *me, vfs_file_handler_t * fh)
     }
     while (n != 0);
 
-    if (fish_get_reply (me, SUP->sockr, NULL, 0) != COMPLETE)
+    if (fish_get_reply (me, SUP->reader, NULL, 0) != COMPLETE)
         vfs_print_message (_("Error reported after abort."));
     else
         vfs_print_message (_("Aborted transfer would be successful."));
@@ -1073,7 +1085,7 @@ fish_linear_read (struct vfs_class *me, vfs_file_handler_t * fh, void *buf, size
 
     len = MIN ((size_t) (fish->total - fish->got), len);
     tty_disable_interrupt_key ();
-    while (len != 0 && ((n = read (SUP->sockr, buf, len)) < 0))
+    while (len != 0 && ((n = vfs_s_reader_read (SUP->reader, buf, len)) < 0))
     {
         if ((errno == EINTR) && !tty_got_interrupt ())
             continue;
@@ -1085,7 +1097,7 @@ fish_linear_read (struct vfs_class *me, vfs_file_handler_t * fh, void *buf, size
         fish->got += n;
     else if (n < 0)
         fish_linear_abort (me, fh);
-    else if (fish_get_reply (me, SUP->sockr, NULL, 0) != COMPLETE)
+    else if (fish_get_reply (me, SUP->reader, NULL, 0) != COMPLETE)
         ERRNOR (E_REMOTE, -1);
     ERRNOR (errno, n);
 }
@@ -1322,6 +1334,123 @@ fish_chown (const vfs_path_t * vpath, uid_t owner, gid_t group)
 
 /* --------------------------------------------------------------------------------------------- */
 
+/** Forget replies to batched deletion which were not requested by fish_unlink() */
+
+static void
+fish_batch_forget (struct vfs_class *me, struct vfs_s_super *super)
+{
+    if (SUP->unlinked != NULL)
+    {
+        g_hash_table_destroy (SUP->unlinked);
+        SUP->unlinked = NULL;
+        vfs_s_invalidate (me, super);
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Delete files of directory by commands sent at once, without waiting for each reply.
+ * All replies are read before return and kept until fish_unlink() is called for
+ * these files, so errors are reported to the file operation as usual. The caller
+ * passes only files it is going to delete anyway, since nothing can be aborted here.
+ *
+ * @return TRUE if commands were sent
+ */
+
+static gboolean
+fish_batch_unlink (const vfs_path_t * vpath, GPtrArray * names)
+{
+    struct vfs_class *me;
+    struct vfs_s_super *super;
+    GPtrArray *paths;
+    GString *cmds;
+    char *dir;
+    guint i;
+    gboolean sent = FALSE;
+
+    if (vfs_s_get_path (vpath, &super, 0) == NULL)
+        return FALSE;
+
+    me = vfs_path_get_by_index (vpath, -1)->class;
+    fish_batch_forget (me, super);
+
+    /* nothing to save if there is one file only */
+    if (names == NULL || names->len < 2)
+        return FALSE;
+
+    /* remote paths are got the same way as in fish_unlink() */
+    paths = g_ptr_array_new ();
+    cmds = g_string_new ("");
+    dir = vfs_path_to_str (vpath);
+
+    for (i = 0; i < names->len; i++)
+    {
+        char *file;
+        vfs_path_t *file_vpath;
+        struct vfs_s_super *file_super;
+        const char *crpath;
+
+        file = concat_dir_and_file (dir, (char *) g_ptr_array_index (names, i));
+        file_vpath = vfs_path_from_str (file);
+        crpath = vfs_s_get_path (file_vpath, &file_super, 0);
+        if (crpath != NULL && file_super == super)
+        {
+            char *rpath;
+
+            g_ptr_array_add (paths, g_strdup (crpath));
+            rpath = strutils_shell_escape (crpath);
+            g_string_append_printf (cmds, "%sFISH_FILENAME=%s;\n%s", SUP->scr_env, rpath,
+                                    SUP->scr_unlink);
+            g_free (rpath);
+        }
+        vfs_path_free (file_vpath);
+        g_free (file);
+    }
+
+    g_free (dir);
+
+    if (paths->len != 0 && fish_command (me, super, NONE, "%s", cmds->str) == COMPLETE)
+    {
+        SUP->unlinked = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+        for (i = 0; i < paths->len; i++)
+        {
+            int r;
+
+            r = fish_get_reply (me, SUP->reader, NULL, 0);
+            g_hash_table_insert (SUP->unlinked, g_ptr_array_index (paths, i),
+                                 GINT_TO_POINTER (r));
+            g_ptr_array_index (paths, i) = NULL;
+        }
+
+        vfs_stamp_create (&vfs_fish_ops, super);
+        sent = TRUE;
+    }
+
+    /* paths of files not sent are freed here, others are owned by SUP->unlinked */
+    g_ptr_array_foreach (paths, (GFunc) g_free, NULL);
+    g_ptr_array_free (paths, TRUE);
+    g_string_free (cmds, TRUE);
+
+    return sent;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static int
+fish_setctl (const vfs_path_t * vpath, int ctlop, void *arg)
+{
+    switch (ctlop)
+    {
+    case VFS_SETCTL_BATCH_UNLINK:
+        return fish_batch_unlink (vpath, (GPtrArray *) arg) ? 1 : 0;
+    default:
+        return vfs_s_setctl (vpath, ctlop, arg);
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
 static int
 fish_unlink (const vfs_path_t * vpath)
 {
@@ -1337,6 +1466,27 @@ fish_unlink (const vfs_path_t * vpath)
     crpath = vfs_s_get_path (vpath, &super, 0);
     if (crpath == NULL)
         return -1;
+
+    if (SUP->unlinked != NULL)
+    {
+        gpointer key, value;
+
+        /* file was deleted by fish_batch_unlink(); reply is returned once,
+           so retry of failed deletion runs command again */
+        if (g_hash_table_lookup_extended (SUP->unlinked, crpath, &key, &value))
+        {
+            int r = GPOINTER_TO_INT (value);
+
+            g_hash_table_remove (SUP->unlinked, crpath);
+            if (r != COMPLETE)
+            {
+                path_element->class->verrno = E_REMOTE;
+                return -1;
+            }
+            return 0;
+        }
+    }
+
     rpath = strutils_shell_escape (crpath);
 
     shell_commands =
@@ -1586,6 +1736,7 @@ init_fish (void)
     vfs_fish_ops.mkdir = fish_mkdir;
     vfs_fish_ops.rmdir = fish_rmdir;
     vfs_fish_ops.ctl = fish_ctl;
+    vfs_fish_ops.setctl = fish_setctl;
     vfs_register_class (&vfs_fish_ops);
 }
 
@@ -18,6 +18,7 @@
 /*** global variables defined in .c file *********************************************************/
 
 extern int fish_directory_timeout;
+extern int fish_use_compression;
 
 /*** declarations of public functions ************************************************************/
 
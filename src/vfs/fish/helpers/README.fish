@@ -97,7 +97,7 @@ may be omitted):
 
 P<unix permissions> <owner>.<group>
 S<size>
-d<3-letters month name> <day> <year or HH:MM>
+d<3-letters month name> <day> <year or HH:MM>, or dMM-DD-YYYY HH:MM[:SS]
 D<year> <month> <day> <hour> <minute> <second>[.1234]
 E<major-of-device>,<minor>
 :<filename>
@@ -146,6 +146,9 @@ int ftpfs_always_use_proxy = 0;
 
 int ftpfs_ignore_chattr_errors = 1;
 
+/* Maximal number of control connections to one server, including the main one */
+int ftpfs_max_connections = 2;
+
 /*** file scope macro definitions ****************************************************************/
 
 #ifndef MAXHOSTNAMELEN
@@ -217,12 +220,27 @@ typedef struct
                                  * "LIST" instead
                                  */
     int ctl_connection_busy;
+    vfs_s_reader_t *reader;     /* buffered reader of replies from control connection */
+    GSList *idle_conns;         /* extra control connections which are not in use now */
+    int num_conns;              /* number of extra control connections */
 } ftp_super_data_t;
 
+/* Extra control connection is used for transfers and listings while the main one is busy */
+typedef struct
+{
+    int sock;
+    int isbinary;
+    int cwd_deferred;
+    int ctl_connection_busy;
+    vfs_s_reader_t *reader;
+    char *cwd;                  /* current directory of the connection */
+} ftp_conn_t;
+
 typedef struct
 {
     int sock;
     int append;
+    ftp_conn_t *conn;           /* extra control connection of transfer, NULL if main one is used */
 } ftp_fh_data_t;
 
 /*** file scope variables ************************************************************************/
@@ -369,14 +387,14 @@ ftpfs_correct_url_parameters (const vfs_path_element_t * velement)
 /* Returns a reply code, check /usr/include/arpa/ftp.h for possible values */
 
 static int
-ftpfs_get_reply (struct vfs_class *me, int sock, char *string_buf, int string_len)
+ftpfs_get_reply (struct vfs_class *me, vfs_s_reader_t * reader, char *string_buf, int string_len)
 {
     char answer[BUF_1K];
     int i;
 
     for (;;)
     {
-        if (!vfs_s_get_line (me, sock, answer, sizeof (answer), '\n'))
+        if (!vfs_s_get_line (me, reader, answer, sizeof (answer), '\n'))
         {
             if (string_buf)
                 *string_buf = 0;
@@ -395,7 +413,7 @@ ftpfs_get_reply (struct vfs_class *me, int sock, char *string_buf, int string_le
             {
                 while (1)
                 {
-                    if (!vfs_s_get_line (me, sock, answer, sizeof (answer), '\n'))
+                    if (!vfs_s_get_line (me, reader, answer, sizeof (answer), '\n'))
                     {
                         if (string_buf)
                             *string_buf = 0;
@@ -514,7 +532,7 @@ ftpfs_command (struct vfs_class *me, struct vfs_s_super *super, int wait_reply,
 
     if (wait_reply)
     {
-        status = ftpfs_get_reply (me, SUP->sock,
+        status = ftpfs_get_reply (me, SUP->reader,
                                   (wait_reply & WANT_STRING) ? reply_str : NULL,
                                   sizeof (reply_str) - 1);
         if ((wait_reply & WANT_STRING) && !retry && !level && code == 421)
@@ -538,15 +556,134 @@ ftpfs_command (struct vfs_class *me, struct vfs_s_super *super, int wait_reply,
 
 /* --------------------------------------------------------------------------------------------- */
 
+/**
+ * Exchange state of the main control connection with an extra connection.
+ * The second call restores the main connection.
+ */
+
+static void
+ftpfs_conn_swap (struct vfs_s_super *super, ftp_conn_t * conn)
+{
+    int i;
+    char *cwd;
+    vfs_s_reader_t *reader;
+
+    i = SUP->sock;
+    SUP->sock = conn->sock;
+    conn->sock = i;
+
+    i = SUP->isbinary;
+    SUP->isbinary = conn->isbinary;
+    conn->isbinary = i;
+
+    i = SUP->cwd_deferred;
+    SUP->cwd_deferred = conn->cwd_deferred;
+    conn->cwd_deferred = i;
+
+    i = SUP->ctl_connection_busy;
+    SUP->ctl_connection_busy = conn->ctl_connection_busy;
+    conn->ctl_connection_busy = i;
+
+    reader = SUP->reader;
+    SUP->reader = conn->reader;
+    conn->reader = reader;
+
+    cwd = super->path_element->path;
+    super->path_element->path = conn->cwd;
+    conn->cwd = cwd;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/**
+ * Get extra control connection to the server of super.
+ *
+ * @return idle connection or new logged in one, NULL if ftpfs_max_connections is reached
+ *         or login failed
+ */
+
+static ftp_conn_t *
+ftpfs_conn_get (struct vfs_class *me, struct vfs_s_super *super)
+{
+    ftp_conn_t *conn;
+
+    if (SUP->idle_conns != NULL)
+    {
+        conn = (ftp_conn_t *) SUP->idle_conns->data;
+        SUP->idle_conns = g_slist_delete_link (SUP->idle_conns, SUP->idle_conns);
+        return conn;
+    }
+
+    if (SUP->num_conns + 1 >= ftpfs_max_connections)
+        return NULL;
+
+    conn = g_new0 (ftp_conn_t, 1);
+    conn->sock = -1;
+    conn->isbinary = TYPE_UNKNOWN;
+    conn->reader = vfs_s_reader_new (-1);
+
+    ftpfs_conn_swap (super, conn);
+    SUP->sock = ftpfs_open_socket (me, super);
+    if (SUP->sock != -1)
+    {
+        if (ftpfs_login_server (me, super, NULL) != 0)
+            super->path_element->path = ftpfs_get_current_directory (me, super);
+        else
+        {
+            close (SUP->sock);
+            SUP->sock = -1;
+        }
+    }
+    ftpfs_conn_swap (super, conn);
+
+    if (conn->sock == -1)
+    {
+        vfs_s_reader_free (conn->reader);
+        g_free (conn);
+        return NULL;
+    }
+
+    SUP->num_conns++;
+    return conn;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+ftpfs_conn_put (struct vfs_s_super *super, ftp_conn_t * conn)
+{
+    SUP->idle_conns = g_slist_prepend (SUP->idle_conns, conn);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
 static void
 ftpfs_free_archive (struct vfs_class *me, struct vfs_s_super *super)
 {
+    while (SUP->idle_conns != NULL)
+    {
+        ftp_conn_t *conn = (ftp_conn_t *) SUP->idle_conns->data;
+
+        SUP->idle_conns = g_slist_delete_link (SUP->idle_conns, SUP->idle_conns);
+
+        ftpfs_conn_swap (super, conn);
+        if (SUP->sock != -1)
+        {
+            ftpfs_command (me, super, NONE, "QUIT");
+            close (SUP->sock);
+        }
+        ftpfs_conn_swap (super, conn);
+        vfs_s_reader_free (conn->reader);
+        g_free (conn->cwd);
+        g_free (conn);
+    }
+
     if (SUP->sock != -1)
     {
         vfs_print_message (_("ftpfs: Disconnecting from %s"), super->path_element->host);
         ftpfs_command (me, super, NONE, "QUIT");
         close (SUP->sock);
     }
+    vfs_s_reader_free (SUP->reader);
     g_free (super->data);
     super->data = NULL;
 }
@@ -578,6 +715,8 @@ ftpfs_login_server (struct vfs_class *me, struct vfs_s_super *super, const char
     char reply_string[BUF_MEDIUM];
 
     SUP->isbinary = TYPE_UNKNOWN;
+    /* greeting is the first reply from new control connection */
+    vfs_s_reader_reset (SUP->reader, SUP->sock);
 
     if (super->path_element->password != NULL)  /* explicit password */
         op = g_strdup (super->path_element->password);
@@ -621,7 +760,7 @@ ftpfs_login_server (struct vfs_class *me, struct vfs_s_super *super, const char
     else
         name = g_strdup (super->path_element->user);
 
-    if (ftpfs_get_reply (me, SUP->sock, reply_string, sizeof (reply_string) - 1) == COMPLETE)
+    if (ftpfs_get_reply (me, SUP->reader, reply_string, sizeof (reply_string) - 1) == COMPLETE)
     {
         char *reply_up;
 
@@ -983,6 +1122,7 @@ ftpfs_open_archive (struct vfs_s_super *super,
     SUP->use_passive_connection = ftpfs_use_passive_connections;
     SUP->strict = ftpfs_use_unix_list_options ? RFC_AUTODETECT : RFC_STRICT;
     SUP->isbinary = TYPE_UNKNOWN;
+    SUP->reader = vfs_s_reader_new (-1);
     SUP->remote_is_amiga = 0;
     super->name = g_strdup ("/");
     super->root =
@@ -1023,7 +1163,7 @@ ftpfs_get_current_directory (struct vfs_class *me, struct vfs_s_super *super)
     char buf[BUF_8K], *bufp, *bufq;
 
     if (ftpfs_command (me, super, NONE, "PWD") == COMPLETE &&
-        ftpfs_get_reply (me, SUP->sock, buf, sizeof (buf)) == COMPLETE)
+        ftpfs_get_reply (me, SUP->reader, buf, sizeof (buf)) == COMPLETE)
     {
         bufp = NULL;
         for (bufq = buf; *bufq; bufq++)
@@ -1400,8 +1540,36 @@ ftpfs_open_data_connection (struct vfs_class *me, struct vfs_s_super *super, con
 
 /* --------------------------------------------------------------------------------------------- */
 
+/** Switch the main control connection to the extra one of file transfer and back */
+
 static void
-ftpfs_linear_abort (struct vfs_class *me, vfs_file_handler_t * fh)
+ftpfs_fh_conn_swap (vfs_file_handler_t * fh)
+{
+    ftp_fh_data_t *ftp = (ftp_fh_data_t *) fh->data;
+
+    if (ftp != NULL && ftp->conn != NULL)
+        ftpfs_conn_swap (FH_SUPER, ftp->conn);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+/** Return the extra control connection of finished file transfer to the pool */
+
+static void
+ftpfs_fh_conn_release (vfs_file_handler_t * fh)
+{
+    ftp_fh_data_t *ftp = (ftp_fh_data_t *) fh->data;
+
+    if (ftp != NULL && ftp->conn != NULL)
+    {
+        ftpfs_conn_put (FH_SUPER, ftp->conn);
+        ftp->conn = NULL;
+    }
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+ftpfs_linear_abort_int (struct vfs_class *me, vfs_file_handler_t * fh)
 {
     struct vfs_s_super *super = FH_SUPER;
     static unsigned char const ipbuf[3] = { IAC, IP, IAC };
@@ -1450,8 +1618,19 @@ ftpfs_linear_abort (struct vfs_class *me, vfs_file_handler_t * fh)
         }
         close (dsock);
     }
-    if ((ftpfs_get_reply (me, SUP->sock, NULL, 0) == TRANSIENT) && (code == 426))
-        ftpfs_get_reply (me, SUP->sock, NULL, 0);
+    if ((ftpfs_get_reply (me, SUP->reader, NULL, 0) == TRANSIENT) && (code == 426))
+        ftpfs_get_reply (me, SUP->reader, NULL, 0);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+ftpfs_linear_abort (struct vfs_class *me, vfs_file_handler_t * fh)
+{
+    ftpfs_fh_conn_swap (fh);
+    ftpfs_linear_abort_int (me, fh);
+    ftpfs_fh_conn_swap (fh);
+    ftpfs_fh_conn_release (fh);
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -1622,7 +1801,7 @@ resolve_symlink_with_ls_options (struct vfs_class *me, struct vfs_s_super *super
     while (fgets (buffer, sizeof (buffer), fp) != NULL);
     tty_disable_interrupt_key ();
     fclose (fp);
-    ftpfs_get_reply (me, SUP->sock, NULL, 0);
+    ftpfs_get_reply (me, SUP->reader, NULL, 0);
 }
 
 /* --------------------------------------------------------------------------------------------- */
@@ -1642,11 +1821,12 @@ resolve_symlink (struct vfs_class *me, struct vfs_s_super *super, struct vfs_s_i
 /* --------------------------------------------------------------------------------------------- */
 
 static int
-ftpfs_dir_load (struct vfs_class *me, struct vfs_s_inode *dir, char *remote_path)
+ftpfs_dir_load_int (struct vfs_class *me, struct vfs_s_inode *dir, char *remote_path)
 {
     struct vfs_s_entry *ent;
     struct vfs_s_super *super = dir->super;
     int sock, num_entries = 0;
+    vfs_s_reader_t *reader;
     char lc_buffer[BUF_8K];
     int cd_first;
 
@@ -1693,21 +1873,23 @@ ftpfs_dir_load (struct vfs_class *me, struct vfs_s_inode *dir, char *remote_path
     tty_enable_interrupt_key ();
 
     vfs_parse_ls_lga_init ();
+    reader = vfs_s_reader_new (sock);
     while (1)
     {
         int i;
         size_t count_spaces = 0;
         int res = vfs_s_get_line_interruptible (me, lc_buffer, sizeof (lc_buffer),
-                                                sock);
+                                                reader);
         if (!res)
             break;
 
         if (res == EINTR)
         {
             me->verrno = ECONNRESET;
+            vfs_s_reader_free (reader);
             close (sock);
             tty_disable_interrupt_key ();
-            ftpfs_get_reply (me, SUP->sock, NULL, 0);
+            ftpfs_get_reply (me, SUP->reader, NULL, 0);
             vfs_print_message (_("%s: failure"), me->name);
             return -1;
         }
@@ -1733,9 +1915,10 @@ ftpfs_dir_load (struct vfs_class *me, struct vfs_s_inode *dir, char *remote_path
         vfs_s_insert_entry (me, dir, ent);
     }
 
+    vfs_s_reader_free (reader);
     close (sock);
     me->verrno = E_REMOTE;
-    if ((ftpfs_get_reply (me, SUP->sock, NULL, 0) != COMPLETE))
+    if ((ftpfs_get_reply (me, SUP->reader, NULL, 0) != COMPLETE))
         goto fallback;
 
     if (num_entries == 0 && cd_first == 0)
@@ -1769,7 +1952,7 @@ ftpfs_dir_load (struct vfs_class *me, struct vfs_s_inode *dir, char *remote_path
            server (UNIX style LIST command) */
         SUP->strict = RFC_STRICT;
         /* I hate goto, but recursive call needs another 8K on stack */
-        /* return ftpfs_dir_load (me, dir, remote_path); */
+        /* return ftpfs_dir_load_int (me, dir, remote_path); */
         cd_first = 1;
         goto again;
     }
@@ -1779,6 +1962,30 @@ ftpfs_dir_load (struct vfs_class *me, struct vfs_s_inode *dir, char *remote_path
 
 /* --------------------------------------------------------------------------------------------- */
 
+static int
+ftpfs_dir_load (struct vfs_class *me, struct vfs_s_inode *dir, char *remote_path)
+{
+    struct vfs_s_super *super = dir->super;
+    ftp_conn_t *conn = NULL;
+    int ret;
+
+    /* a file is being transferred through the main control connection */
+    if (SUP->ctl_connection_busy)
+        conn = ftpfs_conn_get (me, super);
+
+    if (conn == NULL)
+        return ftpfs_dir_load_int (me, dir, remote_path);
+
+    ftpfs_conn_swap (super, conn);
+    ret = ftpfs_dir_load_int (me, dir, remote_path);
+    ftpfs_conn_swap (super, conn);
+    ftpfs_conn_put (super, conn);
+
+    return ret;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
 static int
 ftpfs_file_store (struct vfs_class *me, vfs_file_handler_t * fh, char *name, char *localname)
 {
@@ -1857,14 +2064,14 @@ ftpfs_file_store (struct vfs_class *me, vfs_file_handler_t * fh, char *name, cha
     tty_disable_interrupt_key ();
     close (sock);
     close (h);
-    if (ftpfs_get_reply (me, SUP->sock, NULL, 0) != COMPLETE)
+    if (ftpfs_get_reply (me, SUP->reader, NULL, 0) != COMPLETE)
         ERRNOR (EIO, -1);
     return 0;
   error_return:
     tty_disable_interrupt_key ();
     close (sock);
     close (h);
-    ftpfs_get_reply (me, SUP->sock, NULL, 0);
+    ftpfs_get_reply (me, SUP->reader, NULL, 0);
     return -1;
 }
 
@@ -1873,21 +2080,36 @@ ftpfs_file_store (struct vfs_class *me, vfs_file_handler_t * fh, char *name, cha
 static int
 ftpfs_linear_start (struct vfs_class *me, vfs_file_handler_t * fh, off_t offset)
 {
+    struct vfs_s_super *super = FH_SUPER;
+    ftp_fh_data_t *ftp;
     char *name;
 
     if (fh->data == NULL)
         fh->data = g_new0 (ftp_fh_data_t, 1);
+    ftp = (ftp_fh_data_t *) fh->data;
 
     name = vfs_s_fullpath (me, fh->ino);
     if (name == NULL)
         return 0;
-    FH_SOCK = ftpfs_open_data_connection (me, FH_SUPER, "RETR", name, TYPE_BINARY, offset);
+
+    /* another file is being transferred through the main control connection */
+    if (SUP->ctl_connection_busy)
+        ftp->conn = ftpfs_conn_get (me, super);
+
+    ftpfs_fh_conn_swap (fh);
+    FH_SOCK = ftpfs_open_data_connection (me, super, "RETR", name, TYPE_BINARY, offset);
+    if (FH_SOCK != -1)
+        SUP->ctl_connection_busy = 1;
+    ftpfs_fh_conn_swap (fh);
     g_free (name);
+
     if (FH_SOCK == -1)
+    {
+        ftpfs_fh_conn_release (fh);
         ERRNOR (EACCES, 0);
+    }
     fh->linear = LS_LINEAR_OPEN;
-    ((ftp_super_data_t *) (FH_SUPER->data))->ctl_connection_busy = 1;
-    ((ftp_fh_data_t *) fh->data)->append = 0;
+    ftp->append = 0;
     return 1;
 }
 
@@ -1911,10 +2133,16 @@ ftpfs_linear_read (struct vfs_class *me, vfs_file_handler_t * fh, void *buf, siz
 
     if (n == 0)
     {
+        int reply;
+
+        ftpfs_fh_conn_swap (fh);
         SUP->ctl_connection_busy = 0;
         close (FH_SOCK);
         FH_SOCK = -1;
-        if ((ftpfs_get_reply (me, SUP->sock, NULL, 0) != COMPLETE))
+        reply = ftpfs_get_reply (me, SUP->reader, NULL, 0);
+        ftpfs_fh_conn_swap (fh);
+        ftpfs_fh_conn_release (fh);
+        if (reply != COMPLETE)
             ERRNOR (E_REMOTE, -1);
         return 0;
     }
@@ -2109,6 +2337,7 @@ ftpfs_fh_free_data (vfs_file_handler_t *fh)
 {
     if (fh != NULL)
     {
+        ftpfs_fh_conn_release (fh);
         g_free (fh->data);
         fh->data = NULL;
     }
@@ -2133,13 +2362,18 @@ ftpfs_fh_open (struct vfs_class *me, vfs_file_handler_t * fh, int flags, mode_t
 #else
         int li = 1;
 #endif
+        struct vfs_s_super *super = FH_SUPER;
         char *name;
 
-        /* ftpfs_linear_start() called, so data will be written
-         * to local temporary file and stored to ftp server
+        /* ftpfs_linear_start() called, so data will be stored through
+         * an extra control connection, or, if it cannot be opened,
+         * written to local temporary file and stored to ftp server
          * by vfs_s_close later
          */
-        if (((ftp_super_data_t *) (FH_SUPER->data))->ctl_connection_busy)
+        if (SUP->ctl_connection_busy)
+            ftp->conn = ftpfs_conn_get (me, super);
+
+        if (SUP->ctl_connection_busy && ftp->conn == NULL)
         {
             if (!fh->ino->localname)
             {
@@ -2155,9 +2389,13 @@ ftpfs_fh_open (struct vfs_class *me, vfs_file_handler_t * fh, int flags, mode_t
         name = vfs_s_fullpath (me, fh->ino);
         if (name == NULL)
             goto fail;
+        ftpfs_fh_conn_swap (fh);
         fh->handle =
-            ftpfs_open_data_connection (me, fh->ino->super,
+            ftpfs_open_data_connection (me, super,
                                         (flags & O_APPEND) ? "APPE" : "STOR", name, TYPE_BINARY, 0);
+        if (fh->handle >= 0)
+            SUP->ctl_connection_busy = 1;
+        ftpfs_fh_conn_swap (fh);
         g_free (name);
 
         if (fh->handle < 0)
@@ -2195,7 +2433,8 @@ ftpfs_fh_close (struct vfs_class *me, vfs_file_handler_t * fh)
 {
     if (fh->handle != -1 && !fh->ino->localname)
     {
-        ftp_super_data_t *ftp = (ftp_super_data_t *) fh->ino->super->data;
+        struct vfs_s_super *super = FH_SUPER;
+        int reply;
 
         close (fh->handle);
         fh->handle = -1;
@@ -2203,7 +2442,12 @@ ftpfs_fh_close (struct vfs_class *me, vfs_file_handler_t * fh)
          * we prevent MEDATA->ftpfs_file_store() call from vfs_s_close ()
          */
         fh->changed = 0;
-        if (ftpfs_get_reply (me, ftp->sock, NULL, 0) != COMPLETE)
+        ftpfs_fh_conn_swap (fh);
+        SUP->ctl_connection_busy = 0;
+        reply = ftpfs_get_reply (me, SUP->reader, NULL, 0);
+        ftpfs_fh_conn_swap (fh);
+        ftpfs_fh_conn_release (fh);
+        if (reply != COMPLETE)
             ERRNOR (EIO, -1);
         vfs_s_invalidate (me, FH_SUPER);
     }
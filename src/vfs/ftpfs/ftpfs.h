@@ -32,6 +32,7 @@ extern int ftpfs_use_passive_connections;
 extern int ftpfs_use_passive_connections_over_proxy;
 extern int ftpfs_use_unix_list_options;
 extern int ftpfs_first_cd_then_ls;
+extern int ftpfs_max_connections;
 
 /*** declarations of public functions ************************************************************/
 
@@ -397,6 +397,74 @@ local_lseek (void *data, off_t offset, int whence)
 
 /* --------------------------------------------------------------------------------------------- */
 
+#ifdef HAVE_PREAD
+static ssize_t
+local_pread (void *data, char *buffer, size_t count, off_t offset)
+{
+    ssize_t n;
+
+    if (data == NULL)
+        return -1;
+
+    while ((n = pread (*(int *) data, buffer, count, offset)) == -1 && errno == EINTR)
+        ;
+    return n;
+}
+#endif /* HAVE_PREAD */
+
+/* --------------------------------------------------------------------------------------------- */
+
+#ifdef HAVE_PWRITE
+static ssize_t
+local_pwrite (void *data, const char *buf, size_t count, off_t offset)
+{
+    ssize_t n;
+
+    if (data == NULL)
+        return -1;
+
+    while ((n = pwrite (*(int *) data, buf, count, offset)) == -1 && errno == EINTR)
+        ;
+    return n;
+}
+#endif /* HAVE_PWRITE */
+
+/* --------------------------------------------------------------------------------------------- */
+
+#ifdef HAVE_READV
+static ssize_t
+local_readv (void *data, const struct iovec *iov, int iovcnt)
+{
+    ssize_t n;
+
+    if (data == NULL)
+        return -1;
+
+    while ((n = readv (*(int *) data, iov, iovcnt)) == -1 && errno == EINTR)
+        ;
+    return n;
+}
+#endif /* HAVE_READV */
+
+/* --------------------------------------------------------------------------------------------- */
+
+#ifdef HAVE_WRITEV
+static ssize_t
+local_writev (void *data, const struct iovec *iov, int iovcnt)
+{
+    ssize_t n;
+
+    if (data == NULL)
+        return -1;
+
+    while ((n = writev (*(int *) data, iov, iovcnt)) == -1 && errno == EINTR)
+        ;
+    return n;
+}
+#endif /* HAVE_WRITEV */
+
+/* --------------------------------------------------------------------------------------------- */
+
 void
 init_localfs (void)
 {
@@ -424,6 +492,18 @@ init_localfs (void)
     vfs_local_ops.chdir = local_chdir;
     vfs_local_ops.ferrno = local_errno;
     vfs_local_ops.lseek = local_lseek;
+#ifdef HAVE_PREAD
+    vfs_local_ops.pread = local_pread;
+#endif
+#ifdef HAVE_PWRITE
+    vfs_local_ops.pwrite = local_pwrite;
+#endif
+#ifdef HAVE_READV
+    vfs_local_ops.readv = local_readv;
+#endif
+#ifdef HAVE_WRITEV
+    vfs_local_ops.writev = local_writev;
+#endif
     vfs_local_ops.mknod = local_mknod;
     vfs_local_ops.getlocalcopy = local_getlocalcopy;
     vfs_local_ops.ungetlocalcopy = local_ungetlocalcopy;
@@ -70,6 +70,8 @@
  * Typically many "record"s fit into a "block".
  */
 #define	RECORDSIZE      512
+/* headers are read by blocks of this size while archive is scanned */
+#define	BLOCKSIZE       (128 * RECORDSIZE)
 #define	NAMSIZ          100
 #define	PREFIX_SIZE     155
 #define	TUNMLEN         32
@@ -216,6 +218,7 @@ typedef enum
 typedef struct
 {
     int fd;
+    off_t pos;                  /* Position of fd after the last tar_read(), -1 if unknown */
     struct stat st;
     int type;                   /* Type of the archive */
 } tar_super_data_t;
@@ -225,9 +228,12 @@ typedef struct
 static struct vfs_class vfs_tarfs_ops;
 
 /* As we open one archive at a time, it is safe to have this static */
-static int current_tar_position = 0;
+static off_t current_tar_position = 0;
 
-static union record rec_buf;
+/* block of archive being scanned */
+static union record block_buf[BLOCKSIZE / RECORDSIZE];
+static size_t block_len = 0;    /* number of records in block_buf */
+static size_t block_pos = 0;    /* number of records of block_buf already used */
 
 /*** file scope functions ************************************************************************/
 /* --------------------------------------------------------------------------------------------- */
@@ -302,6 +308,7 @@ tar_open_archive_int (struct vfs_class *me, const vfs_path_t * vpath, struct vfs
     arch = (tar_super_data_t *) archive->data;
     mc_stat (archive_name, &arch->st);
     arch->fd = -1;
+    arch->pos = -1;
     arch->type = TAR_UNKNOWN;
 
     /* Find out the method to handle this tar file */
@@ -346,25 +353,50 @@ tar_open_archive_int (struct vfs_class *me, const vfs_path_t * vpath, struct vfs
 static union record *
 tar_get_next_record (struct vfs_s_super *archive, int tard)
 {
-    int n;
-
     (void) archive;
 
-    n = mc_read (tard, rec_buf.charptr, RECORDSIZE);
-    if (n != RECORDSIZE)
-        return NULL;            /* An error has occurred */
+    if (block_pos == block_len)
+    {
+        size_t n = 0;
+
+        /* fd may be a pipe, so read until block is full */
+        while (n < BLOCKSIZE)
+        {
+            ssize_t r;
+
+            r = mc_read (tard, (char *) block_buf + n, BLOCKSIZE - n);
+            if (r <= 0)
+                break;
+            n += r;
+        }
+
+        /* the tail of incomplete record is dropped */
+        block_len = n / RECORDSIZE;
+        block_pos = 0;
+        if (block_len == 0)
+            return NULL;        /* An error has occurred */
+    }
+
     current_tar_position += RECORDSIZE;
-    return &rec_buf;
+    return &block_buf[block_pos++];
 }
 
 /* --------------------------------------------------------------------------------------------- */
+/** Skip data of archive member: seek only if it doesn't end in the current block */
 
 static void
-tar_skip_n_records (struct vfs_s_super *archive, int tard, int n)
+tar_skip_n_records (struct vfs_s_super *archive, int tard, off_t n)
 {
     (void) archive;
 
-    mc_lseek (tard, n * RECORDSIZE, SEEK_CUR);
+    if (n <= (off_t) (block_len - block_pos))
+        block_pos += n;
+    else
+    {
+        mc_lseek (tard, (n - (block_len - block_pos)) * RECORDSIZE, SEEK_CUR);
+        block_len = block_pos = 0;
+    }
+
     current_tar_position += n * RECORDSIZE;
 }
 
@@ -554,7 +586,7 @@ tar_read_header (struct vfs_class *me, struct vfs_s_super *archive, int tard, si
     if (header->header.linkflag == LF_LONGNAME || header->header.linkflag == LF_LONGLINK)
     {
         char **longp;
-        char *bp, *data;
+        char *bp;
         int size, written;
 
         if (arch->type == TAR_UNKNOWN)
@@ -573,7 +605,9 @@ tar_read_header (struct vfs_class *me, struct vfs_s_super *archive, int tard, si
 
         for (size = *h_size; size > 0; size -= written)
         {
-            data = tar_get_next_record (archive, tard)->charptr;
+            union record *data;
+
+            data = tar_get_next_record (archive, tard);
             if (data == NULL)
             {
                 g_free (*longp);
@@ -585,7 +619,7 @@ tar_read_header (struct vfs_class *me, struct vfs_s_super *archive, int tard, si
             if (written > size)
                 written = size;
 
-            memcpy (bp, data, written);
+            memcpy (bp, data->charptr, written);
             bp += written;
         }
 
@@ -604,7 +638,7 @@ tar_read_header (struct vfs_class *me, struct vfs_s_super *archive, int tard, si
         struct stat st;
         struct vfs_s_entry *entry;
         struct vfs_s_inode *inode = NULL, *parent;
-        long data_position;
+        off_t data_position;
         char *q;
         int len;
         char *current_file_name, *current_link_name;
@@ -726,8 +760,11 @@ tar_read_header (struct vfs_class *me, struct vfs_s_super *archive, int tard, si
 
         if (arch->type == TAR_GNU && header->header.unused.oldgnu.isextended)
         {
-            while (tar_get_next_record (archive, tard)->ext_hdr.isextended != 0)
-                ;
+            union record *ext;
+
+            do
+                ext = tar_get_next_record (archive, tard);
+            while (ext != NULL && ext->ext_hdr.isextended != 0);
             inode->data_offset = current_tar_position;
         }
         return STATUS_SUCCESS;
@@ -754,6 +791,8 @@ tar_open_archive (struct vfs_s_super *archive, const vfs_path_t * vpath,
     if (tard == -1)
         return -1;
 
+    block_len = block_pos = 0;
+
     for (;;)
     {
         size_t h_size;
@@ -765,7 +804,7 @@ tar_open_archive (struct vfs_s_super *archive, const vfs_path_t * vpath,
         {
 
         case STATUS_SUCCESS:
-            tar_skip_n_records (archive, tard, (h_size + RECORDSIZE - 1) / RECORDSIZE);
+            tar_skip_n_records (archive, tard, ((off_t) h_size + RECORDSIZE - 1) / RECORDSIZE);
             continue;
 
             /*
@@ -864,20 +903,28 @@ static ssize_t
 tar_read (void *fh, char *buffer, size_t count)
 {
     off_t begin = FH->ino->data_offset;
-    int fd = ((tar_super_data_t *) FH_SUPER->data)->fd;
+    tar_super_data_t *arch = (tar_super_data_t *) FH_SUPER->data;
     struct vfs_class *me = FH_SUPER->me;
     ssize_t res;
 
-    if (mc_lseek (fd, begin + FH->pos, SEEK_SET) != begin + FH->pos)
+    /* all files of archive share fd, so seek only if other file was read in between */
+    if (arch->pos != begin + FH->pos
+        && mc_lseek (arch->fd, begin + FH->pos, SEEK_SET) != begin + FH->pos)
+    {
+        arch->pos = -1;
         ERRNOR (EIO, -1);
+    }
 
     count = MIN (count, (size_t) (FH->ino->st.st_size - FH->pos));
 
-    res = mc_read (fd, buffer, count);
+    /* position is unknown after failed read */
+    arch->pos = -1;
+    res = mc_read (arch->fd, buffer, count);
     if (res == -1)
         ERRNOR (errno, -1);
 
     FH->pos += res;
+    arch->pos = begin + FH->pos;
     return res;
 }
 
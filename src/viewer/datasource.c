@@ -267,15 +267,13 @@ mcview_file_load_data (mcview_t * view, off_t byte_index)
         return;
 
     blockoffset = mcview_offset_rounddown (byte_index, view->ds_file_datasize);
-    if (mc_lseek (view->ds_file_fd, blockoffset, SEEK_SET) == -1)
-        goto error;
 
     bytes_read = 0;
     while (bytes_read < view->ds_file_datasize)
     {
         res =
-            mc_read (view->ds_file_fd, view->ds_file_data + bytes_read,
-                     view->ds_file_datasize - bytes_read);
+            mc_pread (view->ds_file_fd, view->ds_file_data + bytes_read,
+                      view->ds_file_datasize - bytes_read, blockoffset + (off_t) bytes_read);
         if (res == -1)
             goto error;
         if (res == 0)
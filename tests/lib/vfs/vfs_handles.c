@@ -0,0 +1,140 @@
+/*
+   lib/vfs - test table of open file handles
+
+   Copyright (C) 2011
+   The Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define TEST_SUITE_NAME "/lib/vfs"
+
+#include <config.h>
+
+#include <check.h>
+
+#include "lib/global.h"
+#include "lib/strutil.h"
+#include "lib/vfs/vfs.h"
+
+struct vfs_class vfs_test_ops1, vfs_test_ops2;
+
+static int data1, data2, data3;
+
+static void
+setup (void)
+{
+    str_init_strings (NULL);
+
+    vfs_init ();
+}
+
+static void
+teardown (void)
+{
+    vfs_shut ();
+    str_uninit_strings ();
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+START_TEST (test_vfs_handle_lookup)
+{
+    int h1, h2;
+    void *fsinfo;
+
+    h1 = vfs_new_handle (&vfs_test_ops1, &data1);
+    h2 = vfs_new_handle (&vfs_test_ops2, &data2);
+
+    fail_unless (h1 != h2, "the same handle is given twice");
+
+    fail_unless (vfs_class_find_by_handle (h1, &fsinfo) == &vfs_test_ops1, "wrong class of h1");
+    fail_unless (fsinfo == &data1, "wrong data of h1");
+    fail_unless (vfs_class_find_by_handle (h2, &fsinfo) == &vfs_test_ops2, "wrong class of h2");
+    fail_unless (fsinfo == &data2, "wrong data of h2");
+
+    /* data isn't required */
+    fail_unless (vfs_class_find_by_handle (h1, NULL) == &vfs_test_ops1, "wrong class of h1");
+
+    /* invalid handles */
+    fail_unless (vfs_class_find_by_handle (-1, &fsinfo) == NULL && fsinfo == NULL,
+                 "handle -1 is found");
+    fail_unless (vfs_class_find_by_handle (0, &fsinfo) == NULL && fsinfo == NULL,
+                 "handle 0 is found");
+    fail_unless (vfs_class_find_by_handle (MAX (h1, h2) + 1, &fsinfo) == NULL && fsinfo == NULL,
+                 "handle out of table is found");
+}
+END_TEST
+
+/* --------------------------------------------------------------------------------------------- */
+
+START_TEST (test_vfs_handle_free)
+{
+    int h1, h2, h3, h4;
+    void *fsinfo;
+
+    h1 = vfs_new_handle (&vfs_test_ops1, &data1);
+    h2 = vfs_new_handle (&vfs_test_ops2, &data2);
+
+    vfs_free_handle (h1);
+    fail_unless (vfs_class_find_by_handle (h1, &fsinfo) == NULL && fsinfo == NULL,
+                 "freed handle is found");
+    fail_unless (vfs_class_find_by_handle (h2, &fsinfo) == &vfs_test_ops2 && fsinfo == &data2,
+                 "h2 is lost after h1 is freed");
+
+    /* freeing of free handle is ignored and doesn't break list of free handles */
+    vfs_free_handle (h1);
+
+    h3 = vfs_new_handle (&vfs_test_ops1, &data3);
+    fail_unless (h3 == h1, "freed handle isn't reused");
+    h4 = vfs_new_handle (&vfs_test_ops1, &data1);
+    fail_unless (h4 != h1 && h4 != h2, "handle in use is given again");
+
+    fail_unless (vfs_class_find_by_handle (h3, &fsinfo) == &vfs_test_ops1 && fsinfo == &data3,
+                 "wrong reused handle");
+    fail_unless (vfs_class_find_by_handle (h4, &fsinfo) == &vfs_test_ops1 && fsinfo == &data1,
+                 "wrong new handle");
+}
+END_TEST
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    tcase_add_checked_fixture (tc_core, setup, teardown);
+
+    /* Add new tests here: *************** */
+    tcase_add_test (tc_core, test_vfs_handle_lookup);
+    tcase_add_test (tc_core, test_vfs_handle_free);
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "vfs_handles.log");
+    srunner_run_all (sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? 0 : 1;
+}
+
+/* --------------------------------------------------------------------------------------------- */
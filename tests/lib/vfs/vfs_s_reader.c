@@ -0,0 +1,189 @@
+/*
+   lib/vfs - test buffered reader of network filesystems
+
+   Copyright (C) 2011
+   The Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define TEST_SUITE_NAME "/lib/vfs"
+
+#include <config.h>
+
+#include <check.h>
+
+#include <string.h>
+#include <unistd.h>
+
+#include "lib/global.h"
+#include "lib/vfs/xdirentry.h"
+
+#ifdef ENABLE_VFS_NET
+
+struct vfs_s_subclass test_subclass;
+struct vfs_class vfs_test_ops;
+
+static int fds[2];
+static vfs_s_reader_t *reader;
+
+static void
+setup (void)
+{
+    vfs_s_init_class (&vfs_test_ops, &test_subclass);
+    vfs_test_ops.name = "testfs";
+
+    fail_unless (pipe (fds) == 0, "pipe() failed");
+    reader = vfs_s_reader_new (fds[0]);
+}
+
+static void
+teardown (void)
+{
+    vfs_s_reader_free (reader);
+    close (fds[0]);
+    if (fds[1] != -1)
+        close (fds[1]);
+}
+
+static void
+test_write (const char *data, size_t len)
+{
+    fail_unless (write (fds[1], data, len) == (ssize_t) len, "write() to pipe failed");
+}
+
+static void
+test_close_writer (void)
+{
+    close (fds[1]);
+    fds[1] = -1;
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* line crosses the end of the buffer, so it is split between two reads */
+START_TEST (test_vfs_s_get_line_split)
+{
+    char *line1, *line2;
+    char buf[BUF_8K * 2];
+
+    line1 = g_strnfill (BUF_8K - 10, 'a');
+    line2 = g_strnfill (100, 'b');
+
+    test_write (line1, strlen (line1));
+    test_write ("\n", 1);
+    test_write (line2, strlen (line2));
+    test_write ("\n", 1);
+    test_close_writer ();
+
+    fail_unless (vfs_s_get_line (&vfs_test_ops, reader, buf, sizeof (buf), '\n') == 1,
+                 "first line isn't read");
+    fail_unless (strcmp (buf, line1) == 0, "first line is wrong");
+
+    fail_unless (vfs_s_get_line (&vfs_test_ops, reader, buf, sizeof (buf), '\n') == 1,
+                 "split line isn't read");
+    fail_unless (strcmp (buf, line2) == 0, "split line is wrong (%s)", buf);
+
+    fail_unless (vfs_s_get_line (&vfs_test_ops, reader, buf, sizeof (buf), '\n') == 0,
+                 "line is read after EOF");
+
+    g_free (line1);
+    g_free (line2);
+}
+END_TEST
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* too long line is truncated, the rest of it is discarded */
+START_TEST (test_vfs_s_get_line_truncated)
+{
+    char buf[8];
+    const char *data = "0123456789abcdef\nnext\n";
+
+    test_write (data, strlen (data));
+    test_close_writer ();
+
+    fail_unless (vfs_s_get_line (&vfs_test_ops, reader, buf, sizeof (buf), '\n') == 1,
+                 "long line isn't read");
+    fail_unless (strcmp (buf, "0123456") == 0, "long line isn't truncated (%s)", buf);
+
+    fail_unless (vfs_s_get_line (&vfs_test_ops, reader, buf, sizeof (buf), '\n') == 1,
+                 "next line isn't read");
+    fail_unless (strcmp (buf, "next") == 0, "rest of long line isn't discarded (%s)", buf);
+}
+END_TEST
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* data buffered by vfs_s_get_line() is returned by vfs_s_reader_read() first */
+START_TEST (test_vfs_s_reader_read_buffered)
+{
+    char buf[BUF_SMALL];
+    ssize_t n;
+
+    test_write ("header\n01234", 12);
+
+    fail_unless (vfs_s_get_line (&vfs_test_ops, reader, buf, sizeof (buf), '\n') == 1,
+                 "header isn't read");
+    fail_unless (strcmp (buf, "header") == 0, "header is wrong (%s)", buf);
+
+    /* written after the buffer is filled, so it is read from the pipe */
+    test_write ("56789", 5);
+    test_close_writer ();
+
+    n = vfs_s_reader_read (reader, buf, 10);
+    fail_unless (n == 5 && memcmp (buf, "01234", 5) == 0, "buffered data isn't returned first");
+
+    n = vfs_s_reader_read (reader, buf, 10);
+    fail_unless (n == 5 && memcmp (buf, "56789", 5) == 0, "data isn't read from the pipe");
+
+    n = vfs_s_reader_read (reader, buf, 10);
+    fail_unless (n == 0, "data is read after EOF");
+}
+END_TEST
+
+#endif /* ENABLE_VFS_NET */
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    /* Add new tests here: *************** */
+#ifdef ENABLE_VFS_NET
+    tcase_add_checked_fixture (tc_core, setup, teardown);
+    tcase_add_test (tc_core, test_vfs_s_get_line_split);
+    tcase_add_test (tc_core, test_vfs_s_get_line_truncated);
+    tcase_add_test (tc_core, test_vfs_s_reader_read_buffered);
+#endif /* ENABLE_VFS_NET */
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "vfs_s_reader.log");
+    srunner_run_all (sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? 0 : 1;
+}
+
+/* --------------------------------------------------------------------------------------------- */
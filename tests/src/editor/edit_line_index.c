@@ -0,0 +1,257 @@
+/*
+   src/editor - test index of line starts
+
+   Copyright (C) 2011
+   The Free Software Foundation, Inc.
+
+   This file is part of the Midnight Commander.
+
+   The Midnight Commander is free software: you can redistribute it
+   and/or modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the License,
+   or (at your option) any later version.
+
+   The Midnight Commander is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define TEST_SUITE_NAME "/src/editor"
+
+#include <config.h>
+
+#include <check.h>
+
+#include "lib/global.h"
+
+#include "src/editor/lineindex.c" /* for testing static methods  */
+
+/* text spans several blocks of the index */
+#define TEXT_SIZE (10 * LINE_INDEX_BLOCK + 123)
+
+static GString *text;
+static WEdit *edit;
+
+/* --------------------------------------------------------------------------------------------- */
+/* mocked function: text is kept in one string instead of buffers1 and buffers2 */
+
+int
+edit_get_byte (WEdit * e, long byte_index)
+{
+    (void) e;
+
+    if (byte_index < 0 || byte_index >= (long) text->len)
+        return '\n';
+    return (unsigned char) text->str[byte_index];
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+setup (void)
+{
+    long i;
+
+    text = g_string_sized_new (TEXT_SIZE);
+
+    /* short and long lines, and some empty lines */
+    for (i = 0; i < TEXT_SIZE; i++)
+        g_string_append_c (text, (i % 37 == 0 || (i > 5000 && i < 5003)) ? '\n' : 'x');
+    /* one line is longer than a block */
+    memset (text->str + 20000, 'y', 2 * LINE_INDEX_BLOCK);
+
+    edit = g_new0 (WEdit, 1);
+}
+
+static void
+teardown (void)
+{
+    edit_line_index_free (edit);
+    g_free (edit);
+    g_string_free (text, TRUE);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+static void
+test_set_cursor (long curs1)
+{
+    edit->curs1 = curs1;
+    edit->curs2 = text->len - curs1;
+}
+
+static long
+test_count_lines (long offset)
+{
+    long i, n = 0;
+
+    for (i = 0; i < offset; i++)
+        if (text->str[i] == '\n')
+            n++;
+
+    return n;
+}
+
+static long
+test_find_line (long line)
+{
+    long i;
+
+    if (line <= 0)
+        return 0;
+
+    for (i = 0; i < (long) text->len; i++)
+        if (text->str[i] == '\n' && --line == 0)
+            return i + 1;
+
+    /* beginning of the last line */
+    for (i = text->len; i > 0 && text->str[i - 1] != '\n'; i--)
+        ;
+    return i;
+}
+
+static void
+test_check_index (void)
+{
+    long offset, line, total;
+
+    for (offset = 0; offset <= (long) text->len; offset += 97)
+        fail_unless (edit_line_index_count (edit, offset) == test_count_lines (offset),
+                     "curs1 = %ld: wrong number of lines before %ld", edit->curs1, offset);
+
+    fail_unless (edit_line_index_count (edit, text->len) == test_count_lines (text->len),
+                 "curs1 = %ld: wrong number of lines", edit->curs1);
+
+    total = test_count_lines (text->len);
+    for (line = -1; line <= total + 2; line += 7)
+        fail_unless (edit_line_index_find (edit, line) == test_find_line (line),
+                     "curs1 = %ld: wrong offset of line %ld", edit->curs1, line);
+}
+
+/* --------------------------------------------------------------------------------------------- */
+
+START_TEST (test_line_index_build)
+{
+    const long cursors[] = { 0, 1, 5001, LINE_INDEX_BLOCK, 20000, TEXT_SIZE - 1, TEXT_SIZE };
+    size_t i;
+
+    for (i = 0; i < sizeof (cursors) / sizeof (cursors[0]); i++)
+    {
+        edit_line_index_free (edit);
+        test_set_cursor (cursors[i]);
+        test_check_index ();
+    }
+}
+END_TEST
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* cursor is moved like edit_cursor_move() does */
+START_TEST (test_line_index_cursor_move)
+{
+    test_set_cursor (3000);
+    test_check_index ();
+
+    while (edit->curs1 < 3 * LINE_INDEX_BLOCK)
+    {
+        int c = text->str[edit->curs1];
+
+        edit->curs1++;
+        edit->curs2--;
+        if (c == '\n')
+        {
+            edit_line_index_update (edit, FALSE, edit->curs1 - 1, 1);
+            edit_line_index_update (edit, TRUE, edit->curs2, -1);
+        }
+    }
+    test_check_index ();
+
+    while (edit->curs1 > 100)
+    {
+        int c;
+
+        edit->curs1--;
+        edit->curs2++;
+        c = text->str[edit->curs1];
+        if (c == '\n')
+        {
+            edit_line_index_update (edit, FALSE, edit->curs1, -1);
+            edit_line_index_update (edit, TRUE, edit->curs2 - 1, 1);
+        }
+    }
+    test_check_index ();
+}
+END_TEST
+
+/* --------------------------------------------------------------------------------------------- */
+
+/* newlines are inserted and deleted at cursor like edit_insert() and edit_delete() do */
+START_TEST (test_line_index_insert_delete)
+{
+    int i;
+
+    test_set_cursor (LINE_INDEX_BLOCK - 2);
+    test_check_index ();
+
+    /* insertion before cursor crosses the block boundary */
+    for (i = 0; i < 5; i++)
+    {
+        g_string_insert_c (text, edit->curs1, '\n');
+        edit_line_index_update (edit, FALSE, edit->curs1, 1);
+        edit->curs1++;
+    }
+    test_check_index ();
+
+    /* deletion of newlines after cursor */
+    while (text->str[edit->curs1] != '\n')
+    {
+        edit->curs1++;
+        edit->curs2--;
+    }
+    edit_line_index_free (edit);
+    test_check_index ();
+
+    for (i = 0; i < 3; i++)
+    {
+        if (text->str[edit->curs1] == '\n')
+            edit_line_index_update (edit, TRUE, edit->curs2 - 1, -1);
+        g_string_erase (text, edit->curs1, 1);
+        edit->curs2--;
+    }
+    test_check_index ();
+}
+END_TEST
+
+/* --------------------------------------------------------------------------------------------- */
+
+int
+main (void)
+{
+    int number_failed;
+
+    Suite *s = suite_create (TEST_SUITE_NAME);
+    TCase *tc_core = tcase_create ("Core");
+    SRunner *sr;
+
+    tcase_add_checked_fixture (tc_core, setup, teardown);
+
+    /* Add new tests here: *************** */
+    tcase_add_test (tc_core, test_line_index_build);
+    tcase_add_test (tc_core, test_line_index_cursor_move);
+    tcase_add_test (tc_core, test_line_index_insert_delete);
+    /* *********************************** */
+
+    suite_add_tcase (s, tc_core);
+    sr = srunner_create (s);
+    srunner_set_log (sr, "edit_line_index.log");
+    srunner_run_all (sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+    return (number_failed == 0) ? 0 : 1;
+}
+
+/* --------------------------------------------------------------------------------------------- */